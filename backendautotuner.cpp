@@ -0,0 +1,337 @@
+// backendautotuner.cpp - Benchmark and persist the fastest inference configuration
+#include "backendautotuner.h"
+#include "modelregistry.h"
+#include "settingsmanager.h"
+#include "logger.h"
+#include "utils.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+#include <opencv2/dnn.hpp>
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+const int kTimedRuns = 5;
+const double kMaxRelativeError = 0.05;  // допустимое отклонение FP16/OpenVINO от FP32
+
+bool hasTarget(int backend, int target) {
+    try {
+        std::vector<cv::dnn::Target> targets =
+            cv::dnn::getAvailableTargets(static_cast<cv::dnn::Backend>(backend));
+        return std::find(targets.begin(), targets.end(), target) != targets.end();
+    } catch (const cv::Exception&) {
+        return false;
+    }
+}
+
+// Выход детекций (3D) - по нему сверяются кандидаты с пониженной точностью
+cv::Mat detectionOutput(const std::vector<cv::Mat>& outputs) {
+    for (const cv::Mat& output : outputs) {
+        if (output.dims == 3) {
+            return output;
+        }
+    }
+    return outputs.empty() ? cv::Mat() : outputs[0];
+}
+
+} // namespace
+
+BackendAutotuner& BackendAutotuner::instance() {
+    static BackendAutotuner instance;
+    return instance;
+}
+
+QString BackendAutotuner::environmentTag() {
+    return QString("opencv %1, %2 threads, ort %3")
+        .arg(CV_VERSION)
+        .arg(QThread::idealThreadCount())
+        .arg(DetectorEngine::isAvailable(EngineConfig::Kind::OnnxRuntime) ? 1 : 0);
+}
+
+QString BackendAutotuner::modelHash(const QString& resolvedPath) {
+    QFileInfo info(resolvedPath);
+
+    QMutexLocker locker(&m_hashMutex);
+    auto it = m_hashes.constFind(resolvedPath);
+    if (it != m_hashes.constEnd() && it->lastModified == info.lastModified() && it->size == info.size()) {
+        return it->hash;
+    }
+
+    QFile file(resolvedPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QCryptographicHash hasher(QCryptographicHash::Sha256);
+    hasher.addData(&file);
+
+    HashEntry entry;
+    entry.lastModified = info.lastModified();
+    entry.size = info.size();
+    entry.hash = QString::fromLatin1(hasher.result().toHex().left(16));
+    m_hashes.insert(resolvedPath, entry);
+    return entry.hash;
+}
+
+TunedBackend BackendAutotuner::tune(const QString& modelPath, int inputSize) {
+    QString resolvedPath = ModelRegistry::resolveModelPath(modelPath);
+    if (resolvedPath.isEmpty()) {
+        return TunedBackend();
+    }
+
+    QString hash = modelHash(resolvedPath);
+    if (hash.isEmpty()) {
+        return TunedBackend();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    const QString key = hash + "/" + sizeKey(hash, inputSize);
+    auto it = m_tuned.constFind(key);
+    if (it != m_tuned.constEnd()) {
+        return *it;
+    }
+
+    TunedBackend tuned = loadStored(key);
+    if (tuned.valid) {
+        LOG_INFO(QString("Autotune: using stored configuration for model %1: %2, %3 threads (%4 ms)")
+            .arg(key, tuned.engine.describe()).arg(tuned.threads).arg(tuned.latencyMs, 0, 'f', 1));
+    } else {
+        LOG_INFO(QString("Autotune: benchmarking inference configurations for model %1").arg(key));
+        tuned = benchmark(resolvedPath, inputSize);
+        if (tuned.valid) {
+            store(hash, tuned);
+        }
+    }
+
+    m_tuned.insert(key, tuned);
+    return tuned;
+}
+
+void BackendAutotuner::forget(const QString& modelPath) {
+    QString resolvedPath = ModelRegistry::resolveModelPath(modelPath);
+    if (resolvedPath.isEmpty()) {
+        return;
+    }
+    QString hash = modelHash(resolvedPath);
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_tuned.begin(); it != m_tuned.end();) {
+        if (it.key().startsWith(hash + "/")) {
+            it = m_tuned.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // Пустой тег окружения делает сохраненный результат недействительным
+    SettingsManager& settings = SettingsManager::instance();
+    const QString prefix = QString("autotune/%1/").arg(hash);
+    const QStringList sizes = settings.getValue(prefix + "sizes").toString().split(',', Qt::SkipEmptyParts);
+    for (const QString& size : sizes) {
+        settings.setValue(prefix + size + "/environment", QString());
+    }
+}
+
+QString BackendAutotuner::sizeKey(const QString& hash, int inputSize) {
+    QString fixed = SettingsManager::instance().getValue(QString("autotune/%1/fixedInput").arg(hash)).toString();
+    if (!fixed.isEmpty()) {
+        return fixed;
+    }
+    const int side = inputSize > 0 ? inputSize : 640;
+    return QString("%1x%2").arg(side).arg(side);
+}
+
+QList<BackendAutotuner::Candidate> BackendAutotuner::candidates() const {
+    QList<Candidate> result;
+
+    const int ideal = std::max(1, QThread::idealThreadCount());
+    QList<int> threadCounts;
+    for (int threads : {ideal, ideal / 2, ideal / 4}) {
+        if (threads >= 1 && !threadCounts.contains(threads)) {
+            threadCounts.append(threads);
+        }
+    }
+
+    // Первый кандидат - эталон FP32 для проверки точности остальных
+    for (int threads : threadCounts) {
+        Candidate candidate;
+        candidate.engine.kind = EngineConfig::Kind::OpenCvDnn;
+        candidate.engine.backend = cv::dnn::DNN_BACKEND_OPENCV;
+        candidate.engine.target = cv::dnn::DNN_TARGET_CPU;
+        candidate.threads = threads;
+        candidate.label = QString("OpenCV CPU FP32, %1 threads").arg(threads);
+        result.append(candidate);
+    }
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+    if (hasTarget(cv::dnn::DNN_BACKEND_OPENCV, cv::dnn::DNN_TARGET_CPU_FP16)) {
+        for (int threads : threadCounts) {
+            Candidate candidate;
+            candidate.engine.kind = EngineConfig::Kind::OpenCvDnn;
+            candidate.engine.backend = cv::dnn::DNN_BACKEND_OPENCV;
+            candidate.engine.target = cv::dnn::DNN_TARGET_CPU_FP16;
+            candidate.threads = threads;
+            candidate.label = QString("OpenCV CPU FP16, %1 threads").arg(threads);
+            result.append(candidate);
+        }
+    }
+#endif
+
+    // OpenVINO сам управляет потоками
+    if (hasTarget(cv::dnn::DNN_BACKEND_INFERENCE_ENGINE, cv::dnn::DNN_TARGET_CPU)) {
+        Candidate candidate;
+        candidate.engine.kind = EngineConfig::Kind::OpenCvDnn;
+        candidate.engine.backend = cv::dnn::DNN_BACKEND_INFERENCE_ENGINE;
+        candidate.engine.target = cv::dnn::DNN_TARGET_CPU;
+        candidate.threads = ideal;
+        candidate.label = "OpenVINO CPU";
+        result.append(candidate);
+    }
+
+    if (DetectorEngine::isAvailable(EngineConfig::Kind::OnnxRuntime)) {
+        for (int threads : threadCounts) {
+            Candidate candidate;
+            candidate.engine.kind = EngineConfig::Kind::OnnxRuntime;
+            candidate.engine.intraOpThreads = threads;
+            candidate.threads = threads;
+            candidate.label = QString("ONNX Runtime CPU, %1 threads").arg(threads);
+            result.append(candidate);
+        }
+    }
+
+    return result;
+}
+
+TunedBackend BackendAutotuner::benchmark(const QString& resolvedPath, int inputSize) const {
+    TunedBackend best;
+    cv::Mat reference;
+    CvThreadsScope cvThreads;
+
+    for (const Candidate& candidate : candidates()) {
+        try {
+            cvThreads.set(candidate.engine.kind == EngineConfig::Kind::OpenCvDnn ? candidate.threads : 0);
+
+            std::unique_ptr<DetectorEngine> engine = DetectorEngine::create(candidate.engine);
+            engine->load(resolvedPath);
+
+            cv::Size size = engine->describe().inputSize;
+            const bool fixedInput = !size.empty();
+            if (size.empty()) {
+                int side = inputSize > 0 ? inputSize : 640;
+                size = cv::Size(side, side);
+            }
+
+            // Один и тот же синтетический blob для всех кандидатов
+            int shape[] = {1, 3, size.height, size.width};
+            cv::Mat blob(4, shape, CV_32F);
+            cv::RNG rng(0x5eed);
+            rng.fill(blob, cv::RNG::UNIFORM, 0.0f, 1.0f);
+
+            // Первый прогон - прогрев и сверка с эталоном
+            cv::Mat output = detectionOutput(engine->infer(blob)).clone();
+            if (reference.empty()) {
+                reference = output;
+            } else if (output.size != reference.size) {
+                LOG_WARNING(QString("Autotune: %1 rejected, output shape differs").arg(candidate.label));
+                continue;
+            } else {
+                double scale = std::max(1e-6, cv::norm(reference, cv::NORM_INF));
+                double error = cv::norm(output, reference, cv::NORM_INF) / scale;
+                if (error > kMaxRelativeError) {
+                    LOG_WARNING(QString("Autotune: %1 rejected, relative error %2")
+                        .arg(candidate.label).arg(error, 0, 'g', 3));
+                    continue;
+                }
+            }
+
+            std::vector<double> timings;
+            for (int run = 0; run < kTimedRuns; ++run) {
+                QElapsedTimer timer;
+                timer.start();
+                engine->infer(blob);
+                timings.push_back(timer.nsecsElapsed() / 1e6);
+            }
+            std::nth_element(timings.begin(), timings.begin() + timings.size() / 2, timings.end());
+            double median = timings[timings.size() / 2];
+
+            LOG_INFO(QString("Autotune: %1 - %2 ms").arg(candidate.label).arg(median, 0, 'f', 1));
+
+            if (!best.valid || median < best.latencyMs) {
+                best.engine = candidate.engine;
+                best.threads = candidate.threads;
+                best.latencyMs = median;
+                best.valid = true;
+                best.inputSize = size;
+                best.fixedInput = fixedInput;
+            }
+        } catch (const std::exception& e) {
+            LOG_WARNING(QString("Autotune: %1 skipped: %2").arg(candidate.label).arg(e.what()));
+        }
+    }
+
+    if (best.valid) {
+        LOG_INFO(QString("Autotune: selected %1, %2 threads (%3 ms)")
+            .arg(best.engine.describe()).arg(best.threads).arg(best.latencyMs, 0, 'f', 1));
+    }
+    return best;
+}
+
+TunedBackend BackendAutotuner::loadStored(const QString& key) const {
+    TunedBackend tuned;
+    SettingsManager& settings = SettingsManager::instance();
+    const QString prefix = QString("autotune/%1/").arg(key);
+
+    if (settings.getValue(prefix + "environment").toString() != environmentTag()) {
+        return tuned;
+    }
+
+    QString engine = settings.getValue(prefix + "engine").toString();
+    if (engine == "ort") {
+        tuned.engine.kind = EngineConfig::Kind::OnnxRuntime;
+    } else if (engine == "dnn") {
+        tuned.engine.kind = EngineConfig::Kind::OpenCvDnn;
+    } else {
+        return tuned;
+    }
+
+    tuned.engine.backend = settings.getValue(prefix + "backend", 0).toInt();
+    tuned.engine.target = settings.getValue(prefix + "target", 0).toInt();
+    tuned.engine.interOpThreads = settings.getValue(prefix + "interOpThreads", 1).toInt();
+    tuned.engine.graphOptimizationLevel = settings.getValue(prefix + "graphOptimizationLevel", 99).toInt();
+    tuned.threads = settings.getValue(prefix + "threads", 0).toInt();
+    tuned.engine.intraOpThreads = tuned.threads;
+    tuned.latencyMs = settings.getValue(prefix + "latencyMs", 0.0).toDouble();
+    tuned.valid = tuned.threads > 0;
+    return tuned;
+}
+
+void BackendAutotuner::store(const QString& hash, const TunedBackend& tuned) const {
+    SettingsManager& settings = SettingsManager::instance();
+    const QString size = QString("%1x%2").arg(tuned.inputSize.width).arg(tuned.inputSize.height);
+    const QString modelPrefix = QString("autotune/%1/").arg(hash);
+    if (tuned.fixedInput) {
+        settings.setValue(modelPrefix + "fixedInput", size);
+    }
+    // Замеренные размеры через запятую - для forget()
+    QStringList sizes = settings.getValue(modelPrefix + "sizes").toString().split(',', Qt::SkipEmptyParts);
+    if (!sizes.contains(size)) {
+        sizes.append(size);
+        settings.setValue(modelPrefix + "sizes", sizes.join(','));
+    }
+
+    const QString prefix = modelPrefix + size + "/";
+
+    settings.setValue(prefix + "engine",
+                      tuned.engine.kind == EngineConfig::Kind::OnnxRuntime ? "ort" : "dnn");
+    settings.setValue(prefix + "backend", tuned.engine.backend);
+    settings.setValue(prefix + "target", tuned.engine.target);
+    settings.setValue(prefix + "interOpThreads", tuned.engine.interOpThreads);
+    settings.setValue(prefix + "graphOptimizationLevel", tuned.engine.graphOptimizationLevel);
+    settings.setValue(prefix + "threads", tuned.threads);
+    settings.setValue(prefix + "latencyMs", tuned.latencyMs);
+    // Тег окружения пишется последним: без него запись считается неполной
+    settings.setValue(prefix + "environment", environmentTag());
+}
@@ -0,0 +1,76 @@
+// backendautotuner.h - Benchmark and persist the fastest inference configuration
+#ifndef BACKENDAUTOTUNER_H
+#define BACKENDAUTOTUNER_H
+
+#include "detectorengine.h"
+#include <QString>
+#include <QMap>
+#include <QList>
+#include <QMutex>
+#include <QDateTime>
+
+// Подобранная конфигурация инференса для модели на этой машине
+struct TunedBackend {
+    EngineConfig engine;
+    int threads = 0;        // cv::setNumThreads (OpenCV DNN) или intra-op потоки (ORT)
+    double latencyMs = 0.0; // медиана одиночного прогона на синтетическом blob
+    cv::Size inputSize;     // размер входа, на котором шел замер
+    bool fixedInput = false; // размер задан в модели, а не в YoloParams::inputSize
+    bool valid = false;
+};
+
+// При первом запуске для модели прогоняет доступные комбинации
+// backend/target/точности/числа потоков на синтетическом blob и сохраняет
+// победителя в settings.json по хэшу файла модели и размеру входа (ключ
+// "autotune/<hash>/<W>x<H>"): для моделей с динамическим входом лучший
+// backend и число потоков зависят от YoloParams::inputSize. Для модели со
+// своим размером входа он запоминается ("autotune/<hash>/fixedInput"), и
+// inputSize на выбор записи не влияет.
+// Последующие запуски берут сохраненный результат без повторного замера.
+// Результат сбрасывается, если сменилась версия OpenCV или число ядер.
+class BackendAutotuner {
+public:
+    static BackendAutotuner& instance();
+
+    // Сохраненный или заново подобранный вариант. inputSize используется для
+    // моделей с динамическим входом (0 = 640). Невалидный результат - замер не удался.
+    TunedBackend tune(const QString& modelPath, int inputSize = 0);
+
+    // Удаляет сохраненный результат, следующий tune() замерит заново
+    void forget(const QString& modelPath);
+
+    // SHA-256 файла модели (первые 16 hex-символов), кэшируется по пути и mtime
+    QString modelHash(const QString& resolvedPath);
+
+private:
+    BackendAutotuner() = default;
+    BackendAutotuner(const BackendAutotuner&) = delete;
+    BackendAutotuner& operator=(const BackendAutotuner&) = delete;
+
+    struct Candidate {
+        EngineConfig engine;
+        int threads = 0;
+        QString label;
+    };
+
+    QList<Candidate> candidates() const;
+    TunedBackend benchmark(const QString& resolvedPath, int inputSize) const;
+    // Размер входа для ключа: из модели, если он там задан, иначе inputSize (0 = 640)
+    static QString sizeKey(const QString& hash, int inputSize);
+    TunedBackend loadStored(const QString& key) const;
+    void store(const QString& hash, const TunedBackend& tuned) const;
+    static QString environmentTag();
+
+    struct HashEntry {
+        QDateTime lastModified;
+        qint64 size = 0;
+        QString hash;
+    };
+
+    QMap<QString, HashEntry> m_hashes;
+    QMutex m_hashMutex;
+    QMap<QString, TunedBackend> m_tuned;  // hash -> результат в этом процессе
+    QMutex m_mutex;                       // один замер за раз
+};
+
+#endif // BACKENDAUTOTUNER_H
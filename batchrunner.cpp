@@ -0,0 +1,348 @@
+// batchrunner.cpp - Headless batch mode (--batch) without any widgets
+#include "batchrunner.h"
+#include "folderwatcher.h"
+#include "settingsmanager.h"
+#include "logger.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include <cstring>
+
+namespace {
+
+const QStringList kImageFilters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tif", "*.tiff"};
+
+QTextStream& err() {
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+} // namespace
+
+bool BatchRunner::isBatchInvocation(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BatchRunner::parseArguments(const QStringList& arguments, Options& options) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Cell Analyzer headless batch mode");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Image files, directories or glob patterns (e.g. slides/*.png)",
+                                 "<input>...");
+
+    QCommandLineOption batchOption("batch", "Run without GUI.");
+    QCommandLineOption recursiveOption({"r", "recursive"}, "Descend into subdirectories.");
+    QCommandLineOption outputOption({"o", "output"}, "Output file, '-' for stdout (default).", "path", "-");
+    QCommandLineOption formatOption("format", "Output format: csv or ndjson (default: csv).", "format", "csv");
+    QCommandLineOption coefficientOption("coefficient",
+        "Scale in um/px for diameter_um (default: saved coefficient).", "um/px");
+    QCommandLineOption quietOption({"q", "quiet"}, "Do not print per-image progress.");
+    QCommandLineOption watchOption("watch", "Watch the input directory and append results to --output.");
+    QCommandLineOption rescanOption("rescan", "Watch mode: full rescan interval, s (default: 30).", "s");
+    QCommandLineOption settleOption("settle", "Watch mode: file must be unchanged this long, ms (default: 2000).", "ms");
+
+    QCommandLineOption modelOption("model", "ONNX model path.", "path");
+    QCommandLineOption confOption("conf", "Confidence threshold.", "value");
+    QCommandLineOption iouOption("iou", "NMS IoU threshold.", "value");
+    QCommandLineOption minAreaOption("min-area", "Minimum cell area, px.", "px");
+    QCommandLineOption inputSizeOption("input-size", "Network input side for dynamic models.", "px");
+    QCommandLineOption workersOption("workers", "Parallel workers (0 = auto).", "n");
+    QCommandLineOption threadsOption("threads", "OpenCV threads per worker (0 = auto).", "n");
+    QCommandLineOption batchSizeOption("batch-size", "Images per forward pass.", "n");
+    QCommandLineOption engineOption("engine", "Inference engine: dnn or ort.", "name");
+    QCommandLineOption cudaOption("cuda", "Use the CUDA backend.");
+    QCommandLineOption autotuneOption("autotune", "Pick the fastest CPU backend for this machine.");
+    QCommandLineOption tiledOption("tiled", "Tile high-resolution images at native resolution.");
+    QCommandLineOption tileSizeOption("tile-size", "Tile side, px (0 = model input).", "px");
+    QCommandLineOption tileOverlapOption("tile-overlap", "Tile overlap, px.", "px");
+    QCommandLineOption noMasksOption("no-masks", "Do not decode segmentation masks.");
+    QCommandLineOption noCacheOption("no-cache", "Always run inference, do not use the result cache.");
+
+    parser.addOptions({batchOption, recursiveOption, outputOption, formatOption, coefficientOption, quietOption,
+                       watchOption, rescanOption, settleOption,
+                       modelOption, confOption, iouOption, minAreaOption, inputSizeOption, workersOption,
+                       threadsOption, batchSizeOption, engineOption, cudaOption, autotuneOption, tiledOption,
+                       tileSizeOption, tileOverlapOption, noMasksOption, noCacheOption});
+
+    if (!parser.parse(arguments)) {
+        err() << parser.errorText() << "\n";
+        return false;
+    }
+    if (parser.isSet("help")) {
+        err() << parser.helpText();
+        return false;
+    }
+
+    options.inputs = parser.positionalArguments();
+    if (options.inputs.isEmpty()) {
+        err() << "No inputs given\n" << parser.helpText();
+        return false;
+    }
+
+    options.recursive = parser.isSet(recursiveOption);
+    options.outputPath = parser.value(outputOption);
+    options.quiet = parser.isSet(quietOption);
+    options.watch = parser.isSet(watchOption);
+    if (options.watch) {
+        if (options.inputs.size() != 1 || !QFileInfo(options.inputs.first()).isDir()) {
+            err() << "--watch needs exactly one input directory\n";
+            return false;
+        }
+        if (options.outputPath.isEmpty() || options.outputPath == "-") {
+            err() << "--watch needs an output file (-o)\n";
+            return false;
+        }
+    }
+
+    bool ok = true;
+    options.format = CellExporter::formatFromName(parser.value(formatOption), &ok);
+    if (!ok) {
+        err() << "Unknown format: " << parser.value(formatOption) << "\n";
+        return false;
+    }
+
+    // Числовые опции: любая ошибка разбора - ошибка использования
+    auto readDouble = [&](const QCommandLineOption& option, double& target) {
+        if (!parser.isSet(option)) return true;
+        bool valid = false;
+        double value = parser.value(option).toDouble(&valid);
+        if (!valid) {
+            err() << "Invalid value for --" << option.names().constLast() << ": " << parser.value(option) << "\n";
+            return false;
+        }
+        target = value;
+        return true;
+    };
+    auto readInt = [&](const QCommandLineOption& option, int& target) {
+        if (!parser.isSet(option)) return true;
+        bool valid = false;
+        int value = parser.value(option).toInt(&valid);
+        if (!valid || value < 0) {
+            err() << "Invalid value for --" << option.names().constLast() << ": " << parser.value(option) << "\n";
+            return false;
+        }
+        target = value;
+        return true;
+    };
+
+    ImageProcessor::YoloParams& params = options.params;
+    options.coefficient = SettingsManager::instance().getCoefficient();
+    if (!readDouble(coefficientOption, options.coefficient) ||
+        !readDouble(confOption, params.confThreshold) ||
+        !readDouble(iouOption, params.iouThreshold) ||
+        !readInt(minAreaOption, params.minCellArea) ||
+        !readInt(inputSizeOption, params.inputSize) ||
+        !readInt(workersOption, params.workerCount) ||
+        !readInt(threadsOption, params.threadsPerWorker) ||
+        !readInt(batchSizeOption, params.batchSize) ||
+        !readInt(tileSizeOption, params.tileSize) ||
+        !readInt(tileOverlapOption, params.tileOverlap) ||
+        !readInt(rescanOption, options.rescanSeconds) ||
+        !readInt(settleOption, options.settleMs)) {
+        return false;
+    }
+
+    if (parser.isSet(modelOption)) {
+        params.modelPath = parser.value(modelOption);
+    }
+    if (parser.isSet(engineOption)) {
+        QString engine = parser.value(engineOption).toLower();
+        if (engine == "dnn" || engine == "opencv") {
+            params.engine = EngineConfig::Kind::OpenCvDnn;
+        } else if (engine == "ort" || engine == "onnxruntime") {
+            params.engine = EngineConfig::Kind::OnnxRuntime;
+        } else {
+            err() << "Unknown engine: " << parser.value(engineOption) << "\n";
+            return false;
+        }
+    }
+    params.useCUDA = parser.isSet(cudaOption);
+    params.autotune = parser.isSet(autotuneOption);
+    params.tiledMode = parser.isSet(tiledOption);
+    params.cellCrops = false;  // выгрузка не использует фрагменты клеток
+    if (parser.isSet(noMasksOption)) {
+        params.decodeMasks = false;
+    }
+    if (parser.isSet(noCacheOption)) {
+        params.useResultCache = false;
+    }
+    return true;
+}
+
+QStringList BatchRunner::collectImages(const QStringList& inputs, bool recursive) {
+    QStringList images;
+    QSet<QString> seen;
+    auto add = [&](const QString& path) {
+        QString absolute = QFileInfo(path).absoluteFilePath();
+        if (!seen.contains(absolute)) {
+            seen.insert(absolute);
+            images.append(absolute);
+        }
+    };
+
+    const QDirIterator::IteratorFlags flags = recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags;
+    for (const QString& input : inputs) {
+        QFileInfo info(input);
+        if (info.isFile()) {
+            add(input);
+            continue;
+        }
+
+        // Папка целиком или маска в последнем компоненте пути (shell ее не раскрыл)
+        QString directory = input;
+        QStringList filters = kImageFilters;
+        if (!info.isDir()) {
+            directory = info.path();
+            filters = QStringList{info.fileName()};
+        }
+
+        QStringList found;
+        QDirIterator it(directory, filters, QDir::Files, flags);
+        while (it.hasNext()) {
+            found.append(it.next());
+        }
+        if (found.isEmpty()) {
+            LOG_WARNING(QString("Batch: no images match %1").arg(input));
+            err() << "Warning: no images match " << input << "\n";
+        }
+        // Детерминированный порядок строк в выгрузке
+        found.sort();
+        for (const QString& path : found) {
+            add(path);
+        }
+    }
+    return images;
+}
+
+int BatchRunner::run(const QStringList& arguments) {
+    Options options;
+    if (!parseArguments(arguments, options)) {
+        return UsageError;
+    }
+
+    if (options.watch) {
+        return runWatch(options);
+    }
+
+    QStringList images = collectImages(options.inputs, options.recursive);
+    if (images.isEmpty()) {
+        err() << "No images found\n";
+        return NoInput;
+    }
+
+    LOG_INFO(QString("Batch mode: %1 images").arg(images.size()));
+    err() << "Processing " << images.size() << " images with " << options.params.modelPath << "\n";
+    err().flush();
+
+    ImageProcessor processor;
+    if (!options.quiet) {
+        processor.setProgressCallback([&](int processed, int total, const QString& imagePath, int cellCount) {
+            // Вызывается из нескольких рабочих потоков
+            static QMutex progressMutex;
+            QMutexLocker locker(&progressMutex);
+            err() << "[" << processed << "/" << total << "] " << QFileInfo(imagePath).fileName()
+                  << ": " << cellCount << " cells\n";
+            err().flush();
+        });
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    try {
+        processor.processImages(images, options.params);
+    } catch (const std::exception& e) {
+        err() << "Processing failed: " << e.what() << "\n";
+        return ProcessingError;
+    }
+    const qint64 elapsedMs = timer.elapsed();
+
+    CellTable cells(processor.getDetectedCells());
+    cells.applyCoefficient(options.coefficient);
+
+    try {
+        if (options.outputPath.isEmpty() || options.outputPath == "-") {
+            QTextStream out(stdout);
+            CellExporter::write(out, cells, options.format);
+        } else {
+            CellExporter::writeFile(options.outputPath, cells, options.format);
+        }
+    } catch (const std::exception& e) {
+        err() << e.what() << "\n";
+        return OutputError;
+    }
+
+    const double seconds = elapsedMs / 1000.0;
+    err() << QString("Done: %1 images, %2 cells in %3 s (%4 images/s)\n")
+        .arg(images.size()).arg(cells.size())
+        .arg(seconds, 0, 'f', 2)
+        .arg(seconds > 0 ? images.size() / seconds : 0.0, 0, 'f', 2);
+
+    QString lastError = processor.getLastError();
+    if (!lastError.isEmpty()) {
+        err() << "Errors occurred: " << lastError << "\n";
+        return ProcessingError;
+    }
+    return Success;
+}
+
+int BatchRunner::runWatch(const Options& options) {
+    FolderWatcher::Options watchOptions;
+    watchOptions.directory = options.inputs.first();
+    watchOptions.recursive = options.recursive;
+    watchOptions.outputPath = options.outputPath;
+    watchOptions.format = options.format;
+    watchOptions.coefficient = options.coefficient;
+    watchOptions.rescanIntervalMs = options.rescanSeconds * 1000;
+    watchOptions.settleMs = options.settleMs;
+    watchOptions.params = options.params;
+
+    FolderWatcher watcher(watchOptions);
+    QElapsedTimer timer;
+    int totalImages = 0;
+    int totalCells = 0;
+
+    QObject::connect(&watcher, &FolderWatcher::imagesProcessed, [&](int imageCount, int cellCount) {
+        totalImages += imageCount;
+        totalCells += cellCount;
+        if (!options.quiet) {
+            double seconds = timer.elapsed() / 1000.0;
+            err() << QString("+%1 images, %2 cells (session: %3 images, %4 images/s)\n")
+                .arg(imageCount).arg(cellCount).arg(totalImages)
+                .arg(seconds > 0 ? totalImages / seconds : 0.0, 0, 'f', 2);
+            err().flush();
+        }
+    });
+    QObject::connect(&watcher, &FolderWatcher::errorOccurred, [&](const QString& message) {
+        err() << "Error: " << message << "\n";
+        err().flush();
+        // Модель не загружается - продолжать бессмысленно
+        if (!watcher.isRunning()) {
+            QCoreApplication::exit(ProcessingError);
+        }
+    });
+
+    try {
+        timer.start();
+        watcher.start();
+    } catch (const std::exception& e) {
+        err() << e.what() << "\n";
+        return OutputError;
+    }
+
+    err() << "Watching " << watchOptions.directory << " (" << watcher.processedCount()
+          << " images already processed), results -> " << options.outputPath << "\n";
+    err().flush();
+    return QCoreApplication::exec();
+}
@@ -0,0 +1,52 @@
+// batchrunner.h - Headless batch mode (--batch) without any widgets
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <QStringList>
+#include "imageprocessor.h"
+#include "cellexporter.h"
+
+// Пакетный режим для серверов без дисплея:
+//   CellAnalyzer --batch [опции] <файл|папка|маска>...
+// Запускается под QCoreApplication, гоняет тот же параллельный конвейер
+// ImageProcessor и пишет CSV/NDJSON в формате кнопки "Сохранить"
+// VerificationWidget. Сводка по производительности - в stderr.
+// С --watch вместо разового прохода следит за папкой (см. FolderWatcher)
+// и дописывает результаты в -o до остановки процесса.
+class BatchRunner {
+public:
+    // Коды возврата для скриптов
+    enum ExitCode {
+        Success = 0,
+        UsageError = 1,      // неверные аргументы
+        NoInput = 2,         // не найдено ни одного изображения
+        ProcessingError = 3, // модель не загрузилась или часть изображений не обработана
+        OutputError = 4      // не удалось записать результат
+    };
+
+    // Есть ли --batch среди аргументов; проверяется до создания QApplication
+    static bool isBatchInvocation(int argc, char* argv[]);
+
+    int run(const QStringList& arguments);
+
+private:
+    struct Options {
+        QStringList inputs;
+        bool recursive = false;
+        QString outputPath;  // пусто или "-" = stdout
+        CellExporter::Format format = CellExporter::Format::Csv;
+        double coefficient = 0.0;
+        bool quiet = false;
+        bool watch = false;
+        int rescanSeconds = 30;
+        int settleMs = 2000;
+        ImageProcessor::YoloParams params;
+    };
+
+    // false - ошибка разбора, текст ошибки уже выведен
+    bool parseArguments(const QStringList& arguments, Options& options);
+    static QStringList collectImages(const QStringList& inputs, bool recursive);
+    int runWatch(const Options& options);
+};
+
+#endif // BATCHRUNNER_H
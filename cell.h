@@ -2,6 +2,9 @@
 #define CELL_H
 
 #include <opencv2/opencv.hpp>
+#ifdef CELL_COPY_STATS
+#include <atomic>
+#endif
 
 struct Cell {
     // Основные параметры
@@ -18,89 +21,87 @@ struct Cell {
     int bbox_width = 0;       // Ширина bbox
     int bbox_height = 0;      // Высота bbox
 
+    // Маска сегментации (YOLOv8-seg), пустая если модель без масок
+    cv::Mat mask;             // CV_8U 0/255 размера bbox
+    double equivalentDiameter = 0.0; // Диаметр круга с площадью маски, px
+
     // Параметры для нейросетевой детекции
     int cellType = 0;         // Тип клетки (0 = unknown/not classified, 1+ = class ID)
     std::string cellTypeName = ""; // Название типа клетки (например, "Type A", "Type B")
     float confidence = 1.0f;  // Уверенность детекции (0.0-1.0), для традиционных алгоритмов = 1.0
 
-    // Изображение и путь
-    cv::Mat cellImage;        // Изображение клетки (вырезанный фрагмент)
-    std::string imagePath = "";
+    // Исходное изображение: id в ImageCatalog (путь - ImageCatalog::path), -1 - нет
+    int imageId = -1;
     
     // Совместимость с существующим кодом
     cv::Vec3f circle;         // Координаты и радиус круга (x, y, r)
-    cv::Mat image;            // Изображение клетки (для совместимости)
+    // Фрагмент клетки с отступом - собственная небольшая копия пикселей, чтобы
+    // клетка не удерживала весь декодированный снимок. Общий для копий Cell
+    // (счетчик ссылок cv::Mat); пустой, если фрагменты не строились
+    // (YoloParams::cellCrops)
+    cv::Mat image;
     float diameterPx = 0.0f;  // Диаметр в пикселях (для совместимости)
     float diameterNm = 0.0f;  // Диаметр в нанометрах (для совместимости)
     int pixelDiameter = 0;    // Для совместимости
     
-    // Default constructor
+    // Копирование и перемещение - по умолчанию: cv::Mat копируется как заголовок
+    // со счетчиком ссылок, так что копии Cell делят пиксели маски и фрагмента.
+    // Менять пиксели можно только через mutableMask()/mutableImage(), которые
+    // отделяют собственный буфер, если он еще общий (copy-on-write).
     Cell() = default;
-    
-    // Copy constructor with deep copy of cv::Mat
-    Cell(const Cell& other)
-        : center_x(other.center_x)
-        , center_y(other.center_y)
-        , radius(other.radius)
-        , diameter_pixels(other.diameter_pixels)
-        , diameter_um(other.diameter_um)
-        , area(other.area)
-        , bbox_x(other.bbox_x)
-        , bbox_y(other.bbox_y)
-        , bbox_width(other.bbox_width)
-        , bbox_height(other.bbox_height)
-        , cellType(other.cellType)
-        , cellTypeName(other.cellTypeName)
-        , confidence(other.confidence)
-        , imagePath(other.imagePath)
-        , circle(other.circle)
-        , diameterPx(other.diameterPx)
-        , diameterNm(other.diameterNm)
-        , pixelDiameter(other.pixelDiameter)
-    {
-        if (!other.cellImage.empty()) {
-            cellImage = other.cellImage.clone();
-        }
-        if (!other.image.empty()) {
-            image = other.image.clone();
-        }
+    Cell(const Cell&) = default;
+    Cell(Cell&&) noexcept = default;
+    Cell& operator=(const Cell&) = default;
+    Cell& operator=(Cell&&) noexcept = default;
+
+    cv::Mat& mutableMask() { return detach(mask); }
+    cv::Mat& mutableImage() { return detach(image); }
+
+#ifdef CELL_COPY_STATS
+    // Счетчики копирований - только в сборке самопроверок (CellAnalyzerTests
+    // задает CELL_COPY_STATS); в приложении Cell - обычная структура
+    struct CopyStats {
+        long long copies = 0;        // копирования Cell (перемещения не считаются)
+        long long pixelCopies = 0;   // буферы, отделенные mutableMask()/mutableImage()
+    };
+    static CopyStats copyStats() {
+        return CopyStats{s_copies.load(std::memory_order_relaxed),
+                         s_pixelCopies.load(std::memory_order_relaxed)};
     }
-    
-    // Assignment operator with deep copy of cv::Mat
-    Cell& operator=(const Cell& other) {
-        if (this != &other) {
-            center_x = other.center_x;
-            center_y = other.center_y;
-            radius = other.radius;
-            diameter_pixels = other.diameter_pixels;
-            diameter_um = other.diameter_um;
-            area = other.area;
-            bbox_x = other.bbox_x;
-            bbox_y = other.bbox_y;
-            bbox_width = other.bbox_width;
-            bbox_height = other.bbox_height;
-            cellType = other.cellType;
-            cellTypeName = other.cellTypeName;
-            confidence = other.confidence;
-            imagePath = other.imagePath;
-            circle = other.circle;
-            diameterPx = other.diameterPx;
-            diameterNm = other.diameterNm;
-            pixelDiameter = other.pixelDiameter;
-            
-            if (!other.cellImage.empty()) {
-                cellImage = other.cellImage.clone();
-            } else {
-                cellImage = cv::Mat();
-            }
-            if (!other.image.empty()) {
-                image = other.image.clone();
-            } else {
-                image = cv::Mat();
-            }
+    static void resetCopyStats() {
+        s_copies.store(0, std::memory_order_relaxed);
+        s_pixelCopies.store(0, std::memory_order_relaxed);
+    }
+#endif
+
+private:
+    static cv::Mat& detach(cv::Mat& mat) {
+        if (mat.u && mat.u->refcount > 1) {
+            mat = mat.clone();
+#ifdef CELL_COPY_STATS
+            s_pixelCopies.fetch_add(1, std::memory_order_relaxed);
+#endif
         }
-        return *this;
+        return mat;
     }
+
+#ifdef CELL_COPY_STATS
+    // Пустой член, считающий копирования Cell: сами копии остаются умолчательными
+    struct CopyTally {
+        CopyTally() = default;
+        CopyTally(const CopyTally&) noexcept { s_copies.fetch_add(1, std::memory_order_relaxed); }
+        CopyTally(CopyTally&&) noexcept = default;
+        CopyTally& operator=(const CopyTally&) noexcept {
+            s_copies.fetch_add(1, std::memory_order_relaxed);
+            return *this;
+        }
+        CopyTally& operator=(CopyTally&&) noexcept = default;
+    };
+
+    CopyTally m_copyTally;
+    static inline std::atomic<long long> s_copies{0};
+    static inline std::atomic<long long> s_pixelCopies{0};
+#endif
 };
 
 #endif // CELL_H
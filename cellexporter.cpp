@@ -0,0 +1,102 @@
+// cellexporter.cpp - CSV / NDJSON export of measured cells
+#include "cellexporter.h"
+#include <QFile>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <stdexcept>
+#include <vector>
+
+QVector<CellExporter::MeasuredCell> CellExporter::withCoefficient(const QVector<Cell>& cells, double coefficient) {
+    QVector<MeasuredCell> measured;
+    measured.reserve(cells.size());
+    for (const Cell& cell : cells) {
+        double diameterUm = coefficient > 0 ? cell.diameterPx * coefficient : 0.0;
+        measured.append(qMakePair(cell, diameterUm));
+    }
+    return measured;
+}
+
+CellTable CellExporter::toTable(const QVector<MeasuredCell>& cells) {
+    CellTable table;
+    table.reserve(cells.size());
+    for (const MeasuredCell& measured : cells) {
+        int row = table.append(measured.first);
+        table.diameterUm[row] = measured.second;
+    }
+    return table;
+}
+
+int CellExporter::write(QTextStream& stream, const QVector<MeasuredCell>& cells, Format format,
+                        int firstCellNumber, bool writeHeader) {
+    return write(stream, toTable(cells), format, firstCellNumber, writeHeader);
+}
+
+int CellExporter::write(QTextStream& stream, const CellTable& table, Format format,
+                        int firstCellNumber, bool writeHeader) {
+    if (format == Format::Csv && writeHeader) {
+        stream << "filename,cell_number,center_x,center_y,diameter_pixels,diameter_um\n";
+    }
+
+    // Имя файла - из ImageCatalog один раз на изображение, а не на клетку
+    const ImageCatalog& catalog = ImageCatalog::instance();
+    std::vector<QString> filenames(catalog.size());
+
+    int cellNumber = firstCellNumber;
+    for (int row = 0; row < table.size(); ++row) {
+        const int imageId = table.imageId[row];
+        QString filename;
+        if (imageId >= 0 && imageId < static_cast<int>(filenames.size())) {
+            if (filenames[imageId].isNull()) {
+                filenames[imageId] = catalog.fileName(imageId);
+            }
+            filename = filenames[imageId];
+        }
+        int centerX = table.centerX[row];
+        int centerY = table.centerY[row];
+        float diameterPx = table.diameterPx[row];
+        double diameterUm = table.diameterUm[row];
+
+        if (format == Format::Csv) {
+            stream << QString("%1,%2,%3,%4,%5,%6\n")
+                .arg(filename)
+                .arg(cellNumber++)
+                .arg(centerX)
+                .arg(centerY)
+                .arg(diameterPx)
+                .arg(diameterUm, 0, 'f', 2);
+        } else {
+            // Числа в том же текстовом виде, что и в CSV
+            QJsonObject object;
+            object["filename"] = filename;
+            object["cell_number"] = cellNumber++;
+            object["center_x"] = centerX;
+            object["center_y"] = centerY;
+            object["diameter_pixels"] = QString::number(diameterPx).toDouble();
+            object["diameter_um"] = QString::number(diameterUm, 'f', 2).toDouble();
+            stream << QJsonDocument(object).toJson(QJsonDocument::Compact) << "\n";
+        }
+    }
+    stream.flush();
+    return cellNumber;
+}
+
+void CellExporter::writeFile(const QString& path, const QVector<MeasuredCell>& cells, Format format) {
+    writeFile(path, toTable(cells), format);
+}
+
+void CellExporter::writeFile(const QString& path, const CellTable& table, Format format) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        throw std::runtime_error("Cannot create " + path.toStdString() + ": " + file.errorString().toStdString());
+    }
+    QTextStream stream(&file);
+    write(stream, table, format);
+}
+
+CellExporter::Format CellExporter::formatFromName(const QString& name, bool* ok) {
+    QString lower = name.toLower();
+    if (ok) {
+        *ok = lower == "csv" || lower == "ndjson" || lower == "jsonl";
+    }
+    return lower == "ndjson" || lower == "jsonl" ? Format::Ndjson : Format::Csv;
+}
@@ -0,0 +1,47 @@
+// cellexporter.h - CSV / NDJSON export of measured cells
+#ifndef CELLEXPORTER_H
+#define CELLEXPORTER_H
+
+#include <QVector>
+#include <QPair>
+#include <QString>
+#include <QTextStream>
+#include "cell.h"
+#include "celltable.h"
+
+// Общий формат выгрузки для VerificationWidget и пакетного режима (--batch):
+// одна строка на клетку, сквозная нумерация, диаметр в мкм с двумя знаками.
+class CellExporter {
+public:
+    enum class Format {
+        Csv,     // filename,cell_number,center_x,center_y,diameter_pixels,diameter_um
+        Ndjson   // те же поля, один JSON-объект на строку
+    };
+
+    // Клетка и ее диаметр в мкм (0 - коэффициент не задан)
+    using MeasuredCell = QPair<Cell, double>;
+
+    // Диаметр в мкм по коэффициенту мкм/px для всех клеток
+    static QVector<MeasuredCell> withCoefficient(const QVector<Cell>& cells, double coefficient);
+
+    // Нумерация с firstCellNumber; заголовок CSV только при writeHeader -
+    // так выгрузка дописывается частями (режим наблюдения за папкой).
+    // Возвращает номер для следующей клетки.
+    static int write(QTextStream& stream, const QVector<MeasuredCell>& cells, Format format,
+                     int firstCellNumber = 1, bool writeHeader = true);
+    // То же по столбцам CellTable; диаметр в мкм берется из diameterUm
+    // (CellTable::applyCoefficient)
+    static int write(QTextStream& stream, const CellTable& table, Format format,
+                     int firstCellNumber = 1, bool writeHeader = true);
+
+    // Бросает std::runtime_error, если файл не удалось создать
+    static void writeFile(const QString& path, const QVector<MeasuredCell>& cells, Format format);
+    static void writeFile(const QString& path, const CellTable& table, Format format);
+
+    // Таблица без payload с measured.second в diameterUm
+    static CellTable toTable(const QVector<MeasuredCell>& cells);
+
+    static Format formatFromName(const QString& name, bool* ok = nullptr);
+};
+
+#endif // CELLEXPORTER_H
@@ -0,0 +1,146 @@
+// celltable.cpp - Columnar (structure-of-arrays) store of cell geometry and measurements
+#include "celltable.h"
+#include <algorithm>
+#include <initializer_list>
+
+CellTable::CellTable(const QVector<Cell>& cells, bool withPayload)
+    : m_withPayload(withPayload)
+{
+    reserve(cells.size());
+    for (const Cell& cell : cells) {
+        append(cell);
+    }
+}
+
+void CellTable::reserve(int count) {
+    const size_t n = static_cast<size_t>(count);
+    centerX.reserve(n);
+    centerY.reserve(n);
+    radius.reserve(n);
+    area.reserve(n);
+    diameterPx.reserve(n);
+    diameterUm.reserve(n);
+    bboxX.reserve(n);
+    bboxY.reserve(n);
+    bboxWidth.reserve(n);
+    bboxHeight.reserve(n);
+    confidence.reserve(n);
+    classId.reserve(n);
+    imageId.reserve(n);
+    if (m_withPayload) {
+        payloads.reserve(n);
+    }
+}
+
+void CellTable::clear() {
+    centerX.clear();
+    centerY.clear();
+    radius.clear();
+    area.clear();
+    diameterPx.clear();
+    diameterUm.clear();
+    bboxX.clear();
+    bboxY.clear();
+    bboxWidth.clear();
+    bboxHeight.clear();
+    confidence.clear();
+    classId.clear();
+    imageId.clear();
+    payloads.clear();
+}
+
+int CellTable::append(const Cell& cell) {
+    const int row = size();
+    centerX.push_back(cell.center_x);
+    centerY.push_back(cell.center_y);
+    radius.push_back(cell.radius);
+    area.push_back(cell.area);
+    diameterPx.push_back(cell.diameterPx);
+    diameterUm.push_back(cell.diameter_um);
+    bboxX.push_back(cell.bbox_x);
+    bboxY.push_back(cell.bbox_y);
+    bboxWidth.push_back(cell.bbox_width);
+    bboxHeight.push_back(cell.bbox_height);
+    confidence.push_back(cell.confidence);
+    classId.push_back(cell.cellType);
+    imageId.push_back(cell.imageId);
+
+    if (m_withPayload) {
+        CellPayload payload;
+        payload.image = cell.image;
+        payload.mask = cell.mask;
+        payload.cellTypeName = cell.cellTypeName;
+        payload.circle = cell.circle;
+        payload.diameterPixels = cell.diameter_pixels;
+        payload.equivalentDiameter = cell.equivalentDiameter;
+        payload.diameterNm = cell.diameterNm;
+        payloads.push_back(std::move(payload));
+    }
+    return row;
+}
+
+Cell CellTable::cell(int row) const {
+    Cell cell;
+    cell.center_x = centerX[row];
+    cell.center_y = centerY[row];
+    cell.radius = radius[row];
+    cell.area = area[row];
+    cell.diameterPx = diameterPx[row];
+    cell.diameter_um = diameterUm[row];
+    cell.bbox_x = bboxX[row];
+    cell.bbox_y = bboxY[row];
+    cell.bbox_width = bboxWidth[row];
+    cell.bbox_height = bboxHeight[row];
+    cell.confidence = confidence[row];
+    cell.cellType = classId[row];
+    cell.imageId = imageId[row];
+
+    if (m_withPayload) {
+        const CellPayload& payload = payloads[row];
+        cell.image = payload.image;
+        cell.mask = payload.mask;
+        cell.cellTypeName = payload.cellTypeName;
+        cell.circle = payload.circle;
+        cell.diameter_pixels = payload.diameterPixels;
+        cell.equivalentDiameter = payload.equivalentDiameter;
+        cell.diameterNm = payload.diameterNm;
+    } else {
+        // Без payload поля совместимости восстанавливаются из геометрии
+        cell.circle = cv::Vec3f(cell.center_x, cell.center_y, cell.radius);
+        cell.diameter_pixels = cvRound(cell.diameterPx);
+    }
+    return cell;
+}
+
+QVector<Cell> CellTable::toCells() const {
+    QVector<Cell> cells;
+    cells.reserve(size());
+    for (int row = 0; row < size(); ++row) {
+        cells.append(cell(row));
+    }
+    return cells;
+}
+
+void CellTable::applyCoefficient(double umPerPixel) {
+    const size_t n = diameterPx.size();
+    const float* px = diameterPx.data();
+    double* um = diameterUm.data();
+    if (umPerPixel > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            um[i] = px[i] * umPerPixel;
+        }
+    } else {
+        std::fill(diameterUm.begin(), diameterUm.end(), 0.0);
+    }
+}
+
+void CellTable::scaleGeometry(double factor) {
+    // Как int *= double у Cell: умножение в double и усечение
+    for (std::vector<int>* column : {&centerX, &centerY, &radius}) {
+        int* values = column->data();
+        const size_t n = column->size();
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = static_cast<int>(values[i] * factor);
+        }
+    }
+}
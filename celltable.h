@@ -0,0 +1,78 @@
+// celltable.h - Columnar (structure-of-arrays) store of cell geometry and measurements
+#ifndef CELLTABLE_H
+#define CELLTABLE_H
+
+#include <QVector>
+#include <QString>
+#include <vector>
+#include "cell.h"
+#include "imagecatalog.h"
+
+// Тяжелая и редко нужная часть клетки: фрагмент, маска, имя класса и поля
+// совместимости. Хранится отдельно от числовых столбцов и только по запросу.
+struct CellPayload {
+    cv::Mat image;
+    cv::Mat mask;
+    std::string cellTypeName;
+    cv::Vec3f circle;
+    int diameterPixels = 0;
+    double equivalentDiameter = 0.0;
+    float diameterNm = 0.0f;
+};
+
+// Клетки в виде столбцов: каждое поле - отдельный непрерывный массив, так что
+// статистика, отрисовка и выгрузка читают только нужные им поля, а циклы по
+// одному столбцу векторизуются компилятором. Строка i всех столбцов - одна клетка.
+//
+// Изображение строки - id в ImageCatalog, как и у Cell.
+class CellTable {
+public:
+    // withPayload = false - только числовые столбцы (статистика, разметка, выгрузка)
+    explicit CellTable(bool withPayload = false) : m_withPayload(withPayload) {}
+    explicit CellTable(const QVector<Cell>& cells, bool withPayload = false);
+
+    int size() const { return static_cast<int>(centerX.size()); }
+    bool isEmpty() const { return centerX.empty(); }
+    bool hasPayload() const { return m_withPayload; }
+    void reserve(int count);
+    void clear();
+
+    // Возвращает номер строки
+    int append(const Cell& cell);
+
+    // Собирает Cell обратно; без payload фрагмент и маска пустые
+    Cell cell(int row) const;
+    QVector<Cell> toCells() const;
+
+    QString imagePath(int row) const { return ImageCatalog::instance().path(imageId[row]); }
+
+    // Строки, сгруппированные по изображению (ImageCatalog::groupByImage)
+    ImageCatalog::Grouping groupByImage() const { return ImageCatalog::groupByImage(imageId); }
+
+    // diameterUm = diameterPx * umPerPixel; 0, если коэффициент не задан
+    void applyCoefficient(double umPerPixel);
+
+    // Геометрия для отображения в другом масштабе (центры и радиус усекаются, как в int)
+    void scaleGeometry(double factor);
+
+    std::vector<int> centerX;
+    std::vector<int> centerY;
+    std::vector<int> radius;
+    std::vector<int> area;
+    std::vector<float> diameterPx;
+    std::vector<double> diameterUm;
+    std::vector<int> bboxX;
+    std::vector<int> bboxY;
+    std::vector<int> bboxWidth;
+    std::vector<int> bboxHeight;
+    std::vector<float> confidence;
+    std::vector<int> classId;       // Cell::cellType: 0 = не классифицирована
+    std::vector<int> imageId;       // id в ImageCatalog
+
+    std::vector<CellPayload> payloads;  // по одному на строку при hasPayload()
+
+private:
+    bool m_withPayload = false;
+};
+
+#endif // CELLTABLE_H
@@ -0,0 +1,67 @@
+// detectorengine.cpp - Inference backend interface for the YOLO detector
+#include "detectorengine.h"
+#include "opencvdnnengine.h"
+#ifdef HAVE_ONNXRUNTIME
+#include "onnxruntimeengine.h"
+#endif
+#include "logger.h"
+#include <exception>
+
+QString EngineConfig::key() const {
+    if (kind == Kind::OnnxRuntime) {
+        return QString("ort:%1:%2:%3").arg(intraOpThreads).arg(interOpThreads).arg(graphOptimizationLevel);
+    }
+    return QString("dnn:%1:%2").arg(backend).arg(target);
+}
+
+QString EngineConfig::numericsKey() const {
+    if (kind == Kind::OnnxRuntime) {
+        return QString("ort:%1").arg(graphOptimizationLevel);
+    }
+    return QString("dnn:%1:%2").arg(backend).arg(target);
+}
+
+QString EngineConfig::describe() const {
+    if (kind == Kind::OnnxRuntime) {
+        return QString("ONNX Runtime (intra-op %1, inter-op %2, graph opt %3)")
+            .arg(intraOpThreads).arg(interOpThreads).arg(graphOptimizationLevel);
+    }
+    return QString("OpenCV DNN (backend=%1, target=%2)").arg(backend).arg(target);
+}
+
+void DetectorEngine::warmUp(const cv::Size& inputSize) {
+    try {
+        int shape[] = {1, 3, inputSize.height, inputSize.width};
+        cv::Mat blob(4, shape, CV_32F, cv::Scalar(0));
+        infer(blob);
+    } catch (const std::exception& e) {
+        LOG_WARNING(QString("%1 warm-up failed: %2").arg(name()).arg(e.what()));
+    }
+}
+
+bool DetectorEngine::isAvailable(EngineConfig::Kind kind) {
+    switch (kind) {
+    case EngineConfig::Kind::OpenCvDnn:
+        return true;
+    case EngineConfig::Kind::OnnxRuntime:
+#ifdef HAVE_ONNXRUNTIME
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+std::unique_ptr<DetectorEngine> DetectorEngine::create(const EngineConfig& config) {
+#ifdef HAVE_ONNXRUNTIME
+    if (config.kind == EngineConfig::Kind::OnnxRuntime) {
+        return std::make_unique<OnnxRuntimeEngine>(config);
+    }
+#else
+    if (config.kind == EngineConfig::Kind::OnnxRuntime) {
+        LOG_WARNING("ONNX Runtime engine is not built in (WITH_ONNXRUNTIME=OFF), using OpenCV DNN");
+    }
+#endif
+    return std::make_unique<OpenCvDnnEngine>(config);
+}
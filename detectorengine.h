@@ -0,0 +1,71 @@
+// detectorengine.h - Inference backend interface for the YOLO detector
+#ifndef DETECTORENGINE_H
+#define DETECTORENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <opencv2/core.hpp>
+#include <memory>
+#include <vector>
+
+// Настройки движка инференса. Поля backend/target относятся к OpenCV DNN,
+// поля ort* - к ONNX Runtime; остальные движки их игнорируют.
+struct EngineConfig {
+    enum class Kind {
+        OpenCvDnn,
+        OnnxRuntime
+    };
+
+    Kind kind = Kind::OpenCvDnn;
+
+    // OpenCV DNN
+    int backend = 0;   // cv::dnn::DNN_BACKEND_DEFAULT
+    int target = 0;    // cv::dnn::DNN_TARGET_CPU
+
+    // ONNX Runtime (CPU execution provider)
+    int intraOpThreads = 0;          // 0 = решает ORT
+    int interOpThreads = 1;          // > 1 включает параллельное исполнение графа
+    int graphOptimizationLevel = 99; // 0 - выкл., 1 - basic, 2 - extended, 99 - all
+
+    // Ключ кэша в ModelRegistry: разные настройки - разные экземпляры
+    QString key() const;
+    // Часть key(), от которой зависят сами детекции: движок, backend и target
+    // (FP16, OpenVINO), уровень оптимизации графа ORT; без числа потоков
+    QString numericsKey() const;
+    QString describe() const;
+};
+
+// Входы/выходы загруженной модели
+struct EngineIO {
+    cv::Size inputSize;        // пустой, если пространственные оси динамические
+    QStringList inputNames;
+    QStringList outputNames;
+};
+
+// Движок инференса: загрузка модели, прогрев, прогон пакета, описание входов/выходов.
+// Экземпляр не потокобезопасен: каждый рабочий поток получает свой через ModelRegistry.
+class DetectorEngine {
+public:
+    virtual ~DetectorEngine() = default;
+
+    virtual QString name() const = 0;
+
+    // Бросает std::runtime_error, если модель не читается
+    virtual void load(const QString& modelPath) = 0;
+
+    virtual EngineIO describe() const = 0;
+
+    // blob [N, 3, H, W] -> выходы сети. Выходы действительны до следующего
+    // вызова infer (могут разделять память с движком). Бросает std::exception,
+    // если модель не принимает такой вход (например, фиксированный batch = 1).
+    virtual std::vector<cv::Mat> infer(const cv::Mat& blob) = 0;
+
+    // Первый прогон (fusion слоев, выделение буферов) на нулевом blob
+    void warmUp(const cv::Size& inputSize);
+
+    // Создает движок; если запрошенный не собран, возвращает OpenCV DNN
+    static std::unique_ptr<DetectorEngine> create(const EngineConfig& config);
+    static bool isAvailable(EngineConfig::Kind kind);
+};
+
+#endif // DETECTORENGINE_H
@@ -0,0 +1,423 @@
+// folderwatcher.cpp - Hot-folder watch mode on top of the ImageProcessor pipeline
+#include "folderwatcher.h"
+#include "logger.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTextStream>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+const QStringList kImageFilters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tif", "*.tiff"};
+
+} // namespace
+
+FolderWatcher::FolderWatcher(const Options& options, QObject* parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_indexPath(options.outputPath + ".index")
+{
+    m_options.directory = QDir(options.directory).absolutePath();
+
+    m_rescanTimer.setInterval(std::max(1000, m_options.rescanIntervalMs));
+    connect(&m_rescanTimer, &QTimer::timeout, this, &FolderWatcher::scan);
+
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(std::max(100, m_options.settleMs));
+    connect(&m_settleTimer, &QTimer::timeout, this, &FolderWatcher::scan);
+
+    m_debounceTimer.setSingleShot(true);
+    m_debounceTimer.setInterval(200);
+    connect(&m_debounceTimer, &QTimer::timeout, this, &FolderWatcher::scan);
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        m_debounceTimer.start();
+    });
+    connect(&m_chunkWatcher, &QFutureWatcher<void>::finished, this, &FolderWatcher::onChunkFinished);
+}
+
+FolderWatcher::~FolderWatcher() {
+    stop();
+}
+
+void FolderWatcher::start() {
+    if (m_running) {
+        return;
+    }
+    if (!QFileInfo(m_options.directory).isDir()) {
+        throw std::runtime_error("Watch directory does not exist: " + m_options.directory.toStdString());
+    }
+
+    loadIndex();
+
+    // Проверяем запись заранее, чтобы не обнаружить проблему после инференса
+    QFile output(m_options.outputPath);
+    if (!output.open(QIODevice::Append | QIODevice::Text)) {
+        throw std::runtime_error("Cannot open " + m_options.outputPath.toStdString() + ": " +
+                                 output.errorString().toStdString());
+    }
+    QFile index(m_indexPath);
+    if (!index.open(QIODevice::Append | QIODevice::Text)) {
+        throw std::runtime_error("Cannot open " + m_indexPath.toStdString() + ": " +
+                                 index.errorString().toStdString());
+    }
+
+    m_watcher.addPath(m_options.directory);
+    if (m_options.recursive) {
+        QDirIterator it(m_options.directory, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            m_watcher.addPath(it.next());
+        }
+    }
+
+    m_running = true;
+    m_rescanTimer.start();
+    LOG_INFO(QString("Watching %1 (%2 images already processed), results -> %3")
+        .arg(m_options.directory).arg(m_done.size()).arg(m_options.outputPath));
+    scan();
+}
+
+void FolderWatcher::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_rescanTimer.stop();
+    m_settleTimer.stop();
+    m_debounceTimer.stop();
+    if (!m_watcher.directories().isEmpty()) {
+        m_watcher.removePaths(m_watcher.directories());
+    }
+
+    if (m_chunkWatcher.isRunning()) {
+        m_processor->requestCancel();
+        m_chunkWatcher.waitForFinished();
+        onChunkFinished();
+    }
+    m_pending.clear();
+    m_queue.clear();
+    m_queuedState.clear();
+    LOG_INFO(QString("Stopped watching %1").arg(m_options.directory));
+    reportStatus();
+}
+
+void FolderWatcher::loadIndex() {
+    m_done.clear();
+    m_rows.clear();
+    m_nextCellNumber = 1;
+
+    QFile index(m_indexPath);
+    if (!index.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+
+    // path \t size \t mtime(ms) \t cells \t first cell number. У повторно
+    // обработанного файла несколько строк - действует последняя. В индексах
+    // старого формата (без номера) строки шли подряд с непрерывной нумерацией.
+    QTextStream stream(&index);
+    while (!stream.atEnd()) {
+        QStringList fields = stream.readLine().split('\t');
+        if (fields.size() < 4) {
+            continue;
+        }
+        FileState state;
+        state.size = fields[1].toLongLong();
+        state.modifiedMs = fields[2].toLongLong();
+        CellRange rows;
+        rows.count = fields[3].toInt();
+        rows.first = fields.size() >= 5 ? fields[4].toInt() : m_nextCellNumber;
+        m_done.insert(fields[0], state);
+        m_rows.insert(fields[0], rows);
+        m_nextCellNumber = std::max(m_nextCellNumber, rows.first + rows.count);
+    }
+    LOG_INFO(QString("Watch index loaded: %1 processed images").arg(m_done.size()));
+}
+
+QStringList FolderWatcher::listImages() const {
+    QStringList images;
+    QDirIterator it(m_options.directory, kImageFilters, QDir::Files,
+                    m_options.recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+    while (it.hasNext()) {
+        images.append(it.next());
+    }
+    images.sort();
+    return images;
+}
+
+FolderWatcher::FileState FolderWatcher::fileState(const QFileInfo& info) {
+    FileState state;
+    state.size = info.size();
+    state.modifiedMs = info.lastModified().toMSecsSinceEpoch();
+    return state;
+}
+
+bool FolderWatcher::isReadable(const QString& path) {
+    // Пока копирование не закончено, Windows держит файл открытым без общего чтения
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly);
+}
+
+void FolderWatcher::scan() {
+    if (!m_running) {
+        return;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const QString& path : listImages()) {
+        QFileInfo info(path);
+        FileState state = fileState(info);
+
+        // Уже обработан или стоит в очереди в том же состоянии
+        auto done = m_done.constFind(path);
+        if (done != m_done.constEnd() && *done == state) {
+            continue;
+        }
+        auto queued = m_queuedState.constFind(path);
+        if (queued != m_queuedState.constEnd() && *queued == state) {
+            continue;
+        }
+
+        auto pending = m_pending.find(path);
+        if (pending == m_pending.end()) {
+            m_pending.insert(path, PendingFile{state, now});
+            continue;
+        }
+        if (!(pending->state == state)) {
+            // Файл еще пишется
+            pending->state = state;
+            pending->stableSinceMs = now;
+            continue;
+        }
+        if (state.size > 0 && now - pending->stableSinceMs >= m_options.settleMs && isReadable(path)) {
+            m_pending.erase(pending);
+            if (!m_queuedState.contains(path)) {
+                m_queue.append(path);
+            }
+            m_queuedState.insert(path, state);
+        }
+    }
+
+    if (!m_pending.isEmpty() && !m_settleTimer.isActive()) {
+        m_settleTimer.start();
+    }
+
+    processNextChunk();
+    reportStatus();
+}
+
+void FolderWatcher::processNextChunk() {
+    if (!m_running || m_chunkWatcher.isRunning() || m_queue.isEmpty()) {
+        return;
+    }
+
+    const int count = std::min<int>(std::max(1, m_options.chunkSize), m_queue.size());
+    m_chunk = m_queue.mid(0, count);
+    m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+
+    {
+        QMutexLocker locker(&m_resultsMutex);
+        m_chunkResults.clear();
+    }
+
+    m_processor = new ImageProcessor();
+    m_processor->setResultCallback([this](const QString& imagePath, const QVector<Cell>& cells) {
+        QMutexLocker locker(&m_resultsMutex);
+        m_chunkResults.insert(imagePath, cells);
+    });
+
+    LOG_INFO(QString("Watch: processing %1 new images").arg(m_chunk.size()));
+    ImageProcessor* processor = m_processor;
+    QStringList chunk = m_chunk;
+    ImageProcessor::YoloParams params = m_options.params;
+    params.cellCrops = false;  // только выгрузка: исходные изображения не удерживаются
+    m_chunkWatcher.setFuture(QtConcurrent::run([processor, chunk, params]() {
+        try {
+            processor->processImages(chunk, params);
+        } catch (const std::exception& e) {
+            LOG_ERROR(QString("Watch: processing failed: %1").arg(e.what()));
+        }
+    }));
+    reportStatus();
+}
+
+void FolderWatcher::onChunkFinished() {
+    if (!m_processor) {
+        return;
+    }
+
+    QString lastError = m_processor->getLastError();
+    delete m_processor;
+    m_processor = nullptr;
+
+    QHash<QString, QVector<Cell>> results;
+    {
+        QMutexLocker locker(&m_resultsMutex);
+        results.swap(m_chunkResults);
+    }
+
+    // Выгрузка в порядке обнаружения; необработанные (отмена, модель не
+    // загрузилась) возвращаются в очередь
+    // Номера клеток - в том же порядке, в каком appendOutput их выдаст
+    QVector<Cell> cells;
+    QStringList finished;
+    QStringList retry;
+    QHash<QString, CellRange> ranges;
+    QList<CellRange> superseded;  // строки прежней обработки измененных файлов
+    int nextCellNumber = m_nextCellNumber;
+    for (const QString& path : m_chunk) {
+        auto it = results.constFind(path);
+        if (it == results.constEnd()) {
+            retry.append(path);
+            continue;
+        }
+        cells += *it;
+        CellRange rows;
+        rows.first = nextCellNumber;
+        rows.count = it->size();
+        nextCellNumber += rows.count;
+        ranges.insert(path, rows);
+        auto previous = m_rows.constFind(path);
+        if (previous != m_rows.constEnd() && previous->count > 0) {
+            superseded.append(*previous);
+        }
+        finished.append(path);
+    }
+    m_chunk.clear();
+
+    if (!finished.isEmpty()) {
+        try {
+            if (!superseded.isEmpty()) {
+                removeRows(superseded);
+            }
+            appendOutput(cells);
+            appendIndex(finished, ranges);
+        } catch (const std::exception& e) {
+            LOG_ERROR(QString("Watch: %1").arg(e.what()));
+            emit errorOccurred(QString::fromUtf8(e.what()));
+        }
+    }
+
+    for (const QString& path : finished) {
+        m_done.insert(path, m_queuedState.value(path));
+        m_rows.insert(path, ranges.value(path));
+        m_queuedState.remove(path);
+    }
+    if (!retry.isEmpty()) {
+        if (m_running && finished.isEmpty() && !lastError.isEmpty()) {
+            // Ни одно изображение не обработано - скорее всего модель; не крутимся в цикле
+            emit errorOccurred(lastError);
+            stop();
+            return;
+        }
+        m_queue = retry + m_queue;
+    }
+
+    if (!finished.isEmpty()) {
+        LOG_INFO(QString("Watch: %1 images done, %2 cells").arg(finished.size()).arg(cells.size()));
+        emit imagesProcessed(finished.size(), cells.size());
+    }
+
+    processNextChunk();
+    reportStatus();
+}
+
+void FolderWatcher::appendOutput(const QVector<Cell>& cells) {
+    QFile output(m_options.outputPath);
+    if (!output.open(QIODevice::Append | QIODevice::Text)) {
+        throw std::runtime_error("Cannot append to " + m_options.outputPath.toStdString());
+    }
+    CellTable table(cells);
+    table.applyCoefficient(m_options.coefficient);
+    QTextStream stream(&output);
+    m_nextCellNumber = CellExporter::write(stream, table, m_options.format, m_nextCellNumber, output.size() == 0);
+}
+
+void FolderWatcher::removeRows(const QList<CellRange>& ranges) {
+    QFile output(m_options.outputPath);
+    if (!output.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        throw std::runtime_error("Cannot read " + m_options.outputPath.toStdString());
+    }
+
+    auto superseded = [&ranges](int cellNumber) {
+        return std::any_of(ranges.begin(), ranges.end(), [cellNumber](const CellRange& range) {
+            return cellNumber >= range.first && cellNumber < range.first + range.count;
+        });
+    };
+
+    // Номер клетки: в CSV - пятое поле с конца (имя файла может содержать
+    // запятые), в NDJSON - поле cell_number. Заголовок CSV номера не имеет.
+    QStringList kept;
+    int removed = 0;
+    QTextStream in(&output);
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        bool ok = false;
+        int cellNumber = 0;
+        if (m_options.format == CellExporter::Format::Csv) {
+            QStringList fields = line.split(',');
+            if (fields.size() >= 6) {
+                cellNumber = fields[fields.size() - 5].toInt(&ok);
+            }
+        } else {
+            QJsonValue value = QJsonDocument::fromJson(line.toUtf8()).object().value("cell_number");
+            ok = value.isDouble();
+            cellNumber = value.toInt();
+        }
+        if (ok && superseded(cellNumber)) {
+            ++removed;
+            continue;
+        }
+        kept.append(line);
+    }
+    output.close();
+
+    QSaveFile rewritten(m_options.outputPath);
+    if (!rewritten.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        throw std::runtime_error("Cannot rewrite " + m_options.outputPath.toStdString());
+    }
+    QTextStream out(&rewritten);
+    for (const QString& line : kept) {
+        out << line << '\n';
+    }
+    out.flush();
+    if (!rewritten.commit()) {
+        throw std::runtime_error("Cannot rewrite " + m_options.outputPath.toStdString() + ": " +
+                                 rewritten.errorString().toStdString());
+    }
+    LOG_INFO(QString("Watch: %1 rows of reprocessed images removed from %2")
+        .arg(removed).arg(m_options.outputPath));
+}
+
+void FolderWatcher::appendIndex(const QStringList& paths, const QHash<QString, CellRange>& ranges) {
+    QFile index(m_indexPath);
+    if (!index.open(QIODevice::Append | QIODevice::Text)) {
+        throw std::runtime_error("Cannot append to " + m_indexPath.toStdString());
+    }
+    QTextStream stream(&index);
+    for (const QString& path : paths) {
+        FileState state = m_queuedState.value(path);
+        CellRange rows = ranges.value(path);
+        stream << path << '\t' << state.size << '\t' << state.modifiedMs << '\t' << rows.count
+               << '\t' << rows.first << '\n';
+    }
+}
+
+void FolderWatcher::reportStatus() {
+    QString status;
+    if (!m_running) {
+        status = QString("Наблюдение остановлено (%1 обработано)").arg(m_done.size());
+    } else {
+        status = QString("Папка %1: %2 обработано, %3 в очереди")
+            .arg(QFileInfo(m_options.directory).fileName()).arg(m_done.size()).arg(queuedCount());
+    }
+    emit statusChanged(status);
+}
@@ -0,0 +1,128 @@
+// folderwatcher.h - Hot-folder watch mode on top of the ImageProcessor pipeline
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include "imageprocessor.h"
+#include "cellexporter.h"
+
+// Следит за папкой, куда микроскопы складывают снимки, и обрабатывает
+// новые и измененные изображения порциями. QFileSystemWatcher дает быструю
+// реакцию, периодический пересмотр страхует от пропущенных событий
+// (сетевые диски, переполнение очереди уведомлений).
+//
+// Файл берется в работу, когда его размер и mtime не менялись settleMs
+// и он открывается на чтение - копирование завершено.
+//
+// Результаты дописываются в outputPath; рядом лежит индекс
+// "<outputPath>.index" (путь, размер, mtime, число клеток, номер первой
+// клетки) обработанных файлов. После перезапуска индекс загружается целиком,
+// и уже обработанные изображения не проходят инференс повторно. Индекс
+// пишется после выгрузки: при аварийном завершении последняя порция может
+// попасть в выгрузку дважды.
+//
+// Измененный после обработки файл обрабатывается заново, и его новые строки
+// заменяют старые: перед дописыванием выгрузка переписывается без строк с
+// номерами клеток из прежнего диапазона файла. Номера клеток не переиспользуются,
+// поэтому после замены в сквозной нумерации остаются пропуски. В индекс
+// дописывается новая строка файла; при загрузке действует последняя.
+class FolderWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString directory;
+        bool recursive = false;
+        QString outputPath;
+        CellExporter::Format format = CellExporter::Format::Csv;
+        double coefficient = 0.0;     // мкм/px для diameter_um
+        int rescanIntervalMs = 30000;
+        int settleMs = 2000;
+        int chunkSize = 32;           // изображений за один вызов processImages
+        ImageProcessor::YoloParams params;
+    };
+
+    explicit FolderWatcher(const Options& options, QObject* parent = nullptr);
+    ~FolderWatcher();
+
+    // Загружает индекс и запускает наблюдение. Бросает std::runtime_error,
+    // если папки нет или выгрузку/индекс нельзя открыть на запись.
+    void start();
+
+    // Останавливает наблюдение; начатые изображения текущей порции дорабатываются
+    void stop();
+
+    bool isRunning() const { return m_running; }
+    int processedCount() const { return m_done.size(); }
+    int queuedCount() const { return m_queue.size() + m_pending.size() + m_chunk.size(); }
+    const Options& options() const { return m_options; }
+
+signals:
+    void imagesProcessed(int imageCount, int cellCount);
+    void statusChanged(const QString& status);
+    void errorOccurred(const QString& message);
+
+private slots:
+    void scan();
+    void onChunkFinished();
+
+private:
+    struct FileState {
+        qint64 size = 0;
+        qint64 modifiedMs = 0;
+        bool operator==(const FileState& other) const {
+            return size == other.size && modifiedMs == other.modifiedMs;
+        }
+    };
+    // Номера клеток файла в выгрузке: first .. first + count - 1
+    struct CellRange {
+        int first = 0;
+        int count = 0;
+    };
+    struct PendingFile {
+        FileState state;
+        qint64 stableSinceMs = 0;
+    };
+
+    void loadIndex();
+    void appendIndex(const QStringList& paths, const QHash<QString, CellRange>& ranges);
+    void appendOutput(const QVector<Cell>& cells);
+    void removeRows(const QList<CellRange>& ranges);
+    void processNextChunk();
+    void reportStatus();
+    QStringList listImages() const;
+    static FileState fileState(const QFileInfo& info);
+    static bool isReadable(const QString& path);
+
+    Options m_options;
+    QString m_indexPath;
+    bool m_running = false;
+
+    QFileSystemWatcher m_watcher;
+    QTimer m_rescanTimer;   // периодический полный пересмотр
+    QTimer m_settleTimer;   // повторная проверка файлов, которые еще пишутся
+    QTimer m_debounceTimer; // пачка событий watcher -> один пересмотр
+
+    QHash<QString, FileState> m_done;       // из индекса и обработанные в этом запуске
+    QHash<QString, CellRange> m_rows;       // строки выгрузки файлов из m_done
+    QHash<QString, PendingFile> m_pending;  // ждут окончания записи
+    QStringList m_queue;                    // готовы к обработке, в порядке обнаружения
+    QHash<QString, FileState> m_queuedState;
+
+    // Текущая порция
+    QStringList m_chunk;
+    ImageProcessor* m_processor = nullptr;
+    QFutureWatcher<void> m_chunkWatcher;
+    QMutex m_resultsMutex;
+    QHash<QString, QVector<Cell>> m_chunkResults;  // пишется из рабочих потоков
+
+    int m_nextCellNumber = 1;  // больше всех номеров в выгрузке
+};
+
+#endif // FOLDERWATCHER_H
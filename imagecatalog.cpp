@@ -0,0 +1,86 @@
+// imagecatalog.cpp - Process-wide interning of image paths to dense integer ids
+#include "imagecatalog.h"
+#include <QFileInfo>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <algorithm>
+
+ImageCatalog& ImageCatalog::instance() {
+    static ImageCatalog instance;
+    return instance;
+}
+
+int ImageCatalog::intern(const QString& path) {
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_ids.constFind(path);
+        if (it != m_ids.constEnd()) {
+            return *it;
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    auto it = m_ids.constFind(path);
+    if (it != m_ids.constEnd()) {
+        return *it;  // зарегистрирован другим потоком между блокировками
+    }
+    QFileInfo info(path);
+    const int id = static_cast<int>(m_entries.size());
+    m_entries.push_back(Entry{path, info.fileName(), info.baseName()});
+    m_ids.insert(path, id);
+    return id;
+}
+
+int ImageCatalog::find(const QString& path) const {
+    QReadLocker locker(&m_lock);
+    return m_ids.value(path, -1);
+}
+
+QString ImageCatalog::path(int id) const {
+    QReadLocker locker(&m_lock);
+    return id >= 0 && id < static_cast<int>(m_entries.size()) ? m_entries[id].path : QString();
+}
+
+QString ImageCatalog::fileName(int id) const {
+    QReadLocker locker(&m_lock);
+    return id >= 0 && id < static_cast<int>(m_entries.size()) ? m_entries[id].fileName : QString();
+}
+
+QString ImageCatalog::baseName(int id) const {
+    QReadLocker locker(&m_lock);
+    return id >= 0 && id < static_cast<int>(m_entries.size()) ? m_entries[id].baseName : QString();
+}
+
+int ImageCatalog::size() const {
+    QReadLocker locker(&m_lock);
+    return static_cast<int>(m_entries.size());
+}
+
+ImageCatalog::Grouping ImageCatalog::groupByImage(const std::vector<int>& imageIds) {
+    Grouping grouping;
+    int idCount = 0;
+    for (int id : imageIds) {
+        idCount = std::max(idCount, id + 1);
+    }
+
+    // Подсчет, префиксные суммы, раскладка - устойчиво по исходному порядку
+    grouping.offsets.assign(idCount + 1, 0);
+    for (int id : imageIds) {
+        if (id >= 0) {
+            grouping.offsets[id + 1]++;
+        }
+    }
+    for (int id = 0; id < idCount; ++id) {
+        grouping.offsets[id + 1] += grouping.offsets[id];
+    }
+
+    grouping.order.resize(grouping.offsets[idCount]);
+    std::vector<int> next(grouping.offsets.begin(), grouping.offsets.end() - 1);
+    for (int i = 0; i < static_cast<int>(imageIds.size()); ++i) {
+        const int id = imageIds[i];
+        if (id >= 0) {
+            grouping.order[next[id]++] = i;
+        }
+    }
+    return grouping;
+}
@@ -0,0 +1,61 @@
+// imagecatalog.h - Process-wide interning of image paths to dense integer ids
+#ifndef IMAGECATALOG_H
+#define IMAGECATALOG_H
+
+#include <QString>
+#include <QHash>
+#include <QReadWriteLock>
+#include <vector>
+
+// Каталог путей к изображениям: каждый путь получает плотный id (0, 1, 2, ...),
+// клетка хранит только его (Cell::imageId). Имя файла и baseName вычисляются
+// один раз при регистрации, так что горячие циклы не строят QString и QFileInfo
+// на каждую клетку. Записи не удаляются: изображений на порядки меньше, чем
+// клеток. Потокобезопасен - ImageProcessor регистрирует пути из рабочих потоков.
+class ImageCatalog {
+public:
+    static ImageCatalog& instance();
+
+    // Тот же путь - тот же id
+    int intern(const QString& path);
+    // -1, если путь не зарегистрирован
+    int find(const QString& path) const;
+
+    // Пустая строка для неизвестного id (в том числе -1)
+    QString path(int id) const;
+    QString fileName(int id) const;
+    QString baseName(int id) const;
+    int size() const;
+
+    // Группировка подсчетом по id изображения: два линейных прохода без
+    // сравнения строк. Индексы элементов изображения id лежат в
+    // order[offsets[id] .. offsets[id + 1]) в исходном порядке; элементы с
+    // отрицательным id пропускаются.
+    struct Grouping {
+        std::vector<int> order;
+        std::vector<int> offsets;  // idCount() + 1 элементов
+
+        int idCount() const { return offsets.empty() ? 0 : static_cast<int>(offsets.size()) - 1; }
+        int count(int id) const { return offsets[id + 1] - offsets[id]; }
+        const int* begin(int id) const { return order.data() + offsets[id]; }
+        const int* end(int id) const { return order.data() + offsets[id + 1]; }
+    };
+    static Grouping groupByImage(const std::vector<int>& imageIds);
+
+private:
+    ImageCatalog() = default;
+    ImageCatalog(const ImageCatalog&) = delete;
+    ImageCatalog& operator=(const ImageCatalog&) = delete;
+
+    struct Entry {
+        QString path;
+        QString fileName;
+        QString baseName;
+    };
+
+    std::vector<Entry> m_entries;  // индекс - id
+    QHash<QString, int> m_ids;
+    mutable QReadWriteLock m_lock;
+};
+
+#endif // IMAGECATALOG_H
@@ -2,12 +2,27 @@
 #include "imageprocessor.h"
 #include "utils.h"
 #include "logger.h"
+#include "modelregistry.h"
+#include "tiling.h"
+#include "letterbox.h"
+#include "yolodecoder.h"
+#include "maskdecoder.h"
+#include "nms.h"
+#include "backendautotuner.h"
+#include "resultcache.h"
+#include "imagecatalog.h"
 #include <QFileInfo>
-#include <QDir>
-#include <QCoreApplication>
+#include <QFile>
 #include <QImage>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
 #include <opencv2/dnn.hpp>
 #include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
 
 ImageProcessor::ImageProcessor() : m_debugMode(false) {
     LOG_INFO("ImageProcessor created (ONNX-based)");
@@ -25,39 +40,499 @@ void ImageProcessor::processImages(const QStringList& paths, const YoloParams& p
     LOG_INFO(QString("Model: %1").arg(params.modelPath));
     LOG_INFO(QString("Confidence threshold: %1").arg(params.confThreshold));
 
-    for (const QString& path : paths) {
+    if (paths.isEmpty()) {
+        return;
+    }
+
+    const int imageCount = paths.size();
+    const int workers = resolveWorkerCount(imageCount, params);
+    const EnginePlan plan = planEngine(params, workers);
+    const EngineConfig& engine = plan.engine;
+    const int threadsPerWorker = plan.threadsPerWorker;
+    LOG_INFO(QString("Inference engine: %1").arg(engine.describe()));
+
+    m_retained.clear();
+    m_modelHash.clear();
+    m_engine = engine;
+    if (params.useResultCache) {
+        QString resolvedPath = ModelRegistry::resolveModelPath(params.modelPath);
+        if (!resolvedPath.isEmpty()) {
+            m_modelHash = BackendAutotuner::instance().modelHash(resolvedPath);
+        }
+    }
+
+    // Results are stored per input index and merged in input order afterwards,
+    // so the output does not depend on which worker finished first
+    std::vector<ImageResult> perImageResults(imageCount);
+    std::atomic<int> nextIndex(0);
+    std::atomic<int> processedCount(0);
+    const int batchSize = std::max(1, params.batchSize);
+
+    auto workerLoop = [&]() {
+        ModelRegistry::Lease lease;
         try {
-            processSingleImage(path, params);
+            lease = ModelRegistry::instance().acquire(params.modelPath, engine);
         } catch (const std::exception& e) {
-            LOG_ERROR(QString("Failed to process %1: %2").arg(path).arg(e.what()));
-            m_lastError = QString("Error processing %1: %2").arg(path).arg(e.what());
+            LOG_ERROR(QString("Worker failed to acquire ONNX model: %1").arg(e.what()));
+            QMutexLocker locker(&m_mutex);
+            m_lastError = QString("Error loading model: %1").arg(e.what());
+            return;
+        }
+
+        // Each worker claims the next batchSize images and runs them as one forward pass;
+        // a cancel request is honoured before claiming, so claimed images always finish
+        while (!m_cancelRequested) {
+            int start = nextIndex.fetch_add(batchSize);
+            if (start >= imageCount) {
+                break;
+            }
+            int count = std::min(batchSize, imageCount - start);
+            std::vector<ImageResult> results = processBatch(paths.mid(start, count), params, lease);
+            for (int k = 0; k < count; ++k) {
+                int cellCount = results[k].cells.size();
+                perImageResults[start + k] = std::move(results[k]);
+                if (m_resultCallback) {
+                    m_resultCallback(paths[start + k], perImageResults[start + k].cells);
+                }
+                int processed = ++processedCount;
+                if (m_progressCallback) {
+                    m_progressCallback(processed, imageCount, paths[start + k], cellCount);
+                }
+            }
         }
+    };
+
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
+    CvThreadsScope cvThreads(workers > 1 || plan.autotuned ? threadsPerWorker : 0);
+    if (workers > 1) {
+        LOG_INFO(QString("Parallel batch: %1 workers x %2 OpenCV threads").arg(workers).arg(threadsPerWorker));
+
+        QThreadPool pool;
+        pool.setMaxThreadCount(workers);
+        QList<QFuture<void>> futures;
+        for (int w = 0; w < workers; ++w) {
+            futures.append(QtConcurrent::run(&pool, workerLoop));
+        }
+        for (QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+    } else {
+        workerLoop();
+    }
+
+    size_t retainedBytes = 0;
+    for (const ImageResult& result : perImageResults) {
+        cells += result.cells;
+        if (!result.error.isEmpty()) {
+            m_lastError = result.error;
+        }
+        if (result.retained) {
+            retainedBytes += result.retained->candidates.memoryBytes();
+            m_retained.push_back(result.retained);
+        }
+    }
+    if (params.retainCandidates) {
+        m_retainedParams = params;
+        LOG_INFO(QString("Retained candidates of %1 images for rethreshold (%2 MB)")
+            .arg(m_retained.size()).arg(retainedBytes / (1024.0 * 1024.0), 0, 'f', 1));
     }
 
-    LOG_INFO(QString("Processing complete. Detected %1 cells total").arg(cells.size()));
+    const int processed = processedCount;
+    if (m_cancelRequested) {
+        LOG_WARNING(QString("Processing canceled after %1 of %2 images").arg(processed).arg(imageCount));
+    }
+
+    qint64 elapsedMs = batchTimer.elapsed();
+    LOG_INFO(QString("Processing complete. Detected %1 cells total in %2 ms (%3 images/s)")
+        .arg(cells.size()).arg(elapsedMs)
+        .arg(elapsedMs > 0 ? processed * 1000.0 / elapsedMs : 0.0, 0, 'f', 2));
 }
 
-void ImageProcessor::processSingleImage(const QString& path, const YoloParams& params) {
-    LOG_DEBUG(QString("Processing image: %1").arg(path));
+bool ImageProcessor::rethreshold(const YoloParams& params, const QStringList& paths) {
+    m_lastError.clear();
+    if (m_retained.empty()) {
+        m_lastError = "No retained candidates: run processImages with retainCandidates";
+        LOG_WARNING(m_lastError);
+        return false;
+    }
+
+    // Candidates depend on everything up to decoding; only the thresholds may change
+    const YoloParams& retained = m_retainedParams;
+    if (params.modelPath != retained.modelPath || params.inputSize != retained.inputSize ||
+        params.tiledMode != retained.tiledMode || params.tileSize != retained.tileSize ||
+        params.tileOverlap != retained.tileOverlap || params.decodeMasks != retained.decodeMasks) {
+        m_lastError = "Rethreshold: model, input size, tiling and masks must match the retained run";
+        LOG_WARNING(m_lastError);
+        return false;
+    }
+
+    std::vector<std::shared_ptr<RetainedImage>> selected;
+    if (paths.isEmpty()) {
+        selected = m_retained;
+    } else {
+        for (const QString& path : paths) {
+            auto it = std::find_if(m_retained.begin(), m_retained.end(),
+                                   [&](const std::shared_ptr<RetainedImage>& image) { return image->path == path; });
+            if (it == m_retained.end()) {
+                LOG_WARNING(QString("Rethreshold: no retained candidates for %1").arg(path));
+                continue;
+            }
+            selected.push_back(*it);
+        }
+    }
+    for (const std::shared_ptr<RetainedImage>& image : selected) {
+        if (params.confThreshold < image->candidates.scoreFloor - 1e-6) {
+            m_lastError = QString("Rethreshold: confThreshold %1 is below the retained floor %2")
+                .arg(params.confThreshold).arg(image->candidates.scoreFloor);
+            LOG_WARNING(m_lastError);
+            return false;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Images are independent: filtering, NMS, masks and crops run in parallel.
+    // Only the crops need pixels, so the file is decoded again just for them
+    std::vector<QVector<Cell>> results(selected.size());
+    QStringList errors;
+    QMutex errorsMutex;
+    std::vector<int> order(selected.size());
+    std::iota(order.begin(), order.end(), 0);
+    QtConcurrent::blockingMap(order, [&](int i) {
+        const RetainedImage& image = *selected[i];
+        try {
+            cv::Mat source;
+            if (params.cellCrops) {
+                source = loadImageSafely(image.path);
+                if (source.empty()) {
+                    LOG_WARNING(QString("Rethreshold: cannot reload %1, cells without crops").arg(image.path));
+                }
+            }
+            results[i] = finalizeCells(source, image.path,
+                                       cellsFromCandidates(image.candidates, image.path, params),
+                                       image.umPerPixel, params.cellCrops && !source.empty());
+        } catch (const std::exception& e) {
+            LOG_ERROR(QString("Failed to rethreshold %1: %2").arg(image.path).arg(e.what()));
+            QMutexLocker locker(&errorsMutex);
+            errors.append(QString("Error processing %1: %2").arg(image.path).arg(e.what()));
+        }
+    });
+
+    cells.clear();
+    const int total = static_cast<int>(selected.size());
+    for (int i = 0; i < total; ++i) {
+        cells += results[i];
+        if (m_resultCallback) {
+            m_resultCallback(selected[i]->path, results[i]);
+        }
+        if (m_progressCallback) {
+            m_progressCallback(i + 1, total, selected[i]->path, results[i].size());
+        }
+    }
+    if (!errors.isEmpty()) {
+        m_lastError = errors.last();
+    }
+
+    LOG_INFO(QString("Rethreshold (conf %1, iou %2, min area %3): %4 cells in %5 images, %6 ms")
+        .arg(params.confThreshold).arg(params.iouThreshold).arg(params.minCellArea)
+        .arg(cells.size()).arg(total).arg(timer.elapsed()));
+    return errors.isEmpty();
+}
+
+bool ImageProcessor::hasRetainedCandidates(const QString& path) const {
+    if (path.isEmpty()) {
+        return !m_retained.empty();
+    }
+    return std::any_of(m_retained.begin(), m_retained.end(),
+                       [&](const std::shared_ptr<RetainedImage>& image) { return image->path == path; });
+}
+
+size_t ImageProcessor::retainedCandidateCount(const QString& path) const {
+    size_t count = 0;
+    for (const std::shared_ptr<RetainedImage>& image : m_retained) {
+        if (path.isEmpty() || image->path == path) {
+            count += image->candidates.size();
+        }
+    }
+    return count;
+}
+
+void ImageProcessor::releaseCandidates() {
+    m_retained.clear();
+}
 
-    // Load image to get scale
-    cv::Mat src = loadImageSafely(path);
-    if (src.empty()) {
-        throw std::runtime_error("Failed to load image: " + path.toStdString());
+int ImageProcessor::resolveWorkerCount(int imageCount, const YoloParams& params) {
+    int workers = params.workerCount;
+    if (workers <= 0) {
+        // Каждому воркеру оставляем ~4 потока OpenCV на свертки: на 16 ядрах это
+        // 4 изображения одновременно. GPU обслуживает один воркер.
+        workers = params.useCUDA ? 1 : std::max(1, QThread::idealThreadCount() / 4);
+    }
+    return std::max(1, std::min(workers, imageCount));
+}
+
+bool ImageProcessor::warmUp(const YoloParams& params, QString* error) {
+    // Тот же план движка, что и у полного пакета: processImages получит
+    // из ModelRegistry уже загруженные и прогретые экземпляры
+    const int workers = resolveWorkerCount(std::numeric_limits<int>::max(), params);
+    const EnginePlan plan = planEngine(params, workers);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // По экземпляру на воркер, загрузка параллельно. Аренды держатся до конца
+    // прогрева: иначе освобожденный движок выдался бы следующей задаче
+    // повторно, и в пуле оказалось бы меньше экземпляров, чем воркеров
+    std::vector<ModelRegistry::Lease> leases;
+    QString firstError;
+    QMutex mutex;
+    auto warmOne = [&]() {
+        try {
+            ModelRegistry::Lease lease = ModelRegistry::instance().acquire(params.modelPath, plan.engine);
+
+            // ModelRegistry прогревает движок на размере входа модели; для моделей
+            // с динамическими осями дополнительно прогоняем рабочий размер
+            cv::Size inputSize = resolveInputSize(lease, params);
+            if (inputSize != lease.modelInputSize()) {
+                lease.engine().warmUp(inputSize);
+            }
+            QMutexLocker locker(&mutex);
+            leases.push_back(std::move(lease));
+        } catch (const std::exception& e) {
+            QMutexLocker locker(&mutex);
+            if (firstError.isEmpty()) {
+                firstError = QString::fromUtf8(e.what());
+            }
+        }
+    };
+
+    CvThreadsScope cvThreads(workers > 1 || plan.autotuned ? plan.threadsPerWorker : 0);
+    if (workers > 1) {
+        QThreadPool pool;
+        pool.setMaxThreadCount(workers);
+        QList<QFuture<void>> futures;
+        for (int w = 0; w < workers; ++w) {
+            futures.append(QtConcurrent::run(&pool, warmOne));
+        }
+        for (QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+    } else {
+        warmOne();
+    }
+
+    if (!firstError.isEmpty()) {
+        LOG_ERROR(QString("Model warm-up failed: %1").arg(firstError));
+        if (error) {
+            *error = firstError;
+        }
+        return false;
+    }
+
+    LOG_INFO(QString("Model warm-up finished in %1 ms: %2 x %3")
+        .arg(timer.elapsed()).arg(leases.size()).arg(plan.engine.describe()));
+    return true;
+}
+
+ImageProcessor::EnginePlan ImageProcessor::planEngine(const YoloParams& params, int workers) {
+    EnginePlan plan;
+    const int idealThreads = std::max(1, QThread::idealThreadCount());
+    plan.threadsPerWorker = params.threadsPerWorker > 0
+        ? params.threadsPerWorker : std::max(1, idealThreads / workers);
+    plan.engine = engineConfig(params, plan.threadsPerWorker);
+
+    // Автоподбор заменяет выбранный движок замеренным на этой машине;
+    // замер идет одним воркером, поэтому его число потоков - верхняя граница
+    if (params.autotune && !params.useCUDA) {
+        TunedBackend tuned = BackendAutotuner::instance().tune(params.modelPath, params.inputSize);
+        if (tuned.valid) {
+            plan.engine = tuned.engine;
+            if (params.threadsPerWorker <= 0) {
+                plan.threadsPerWorker = std::max(1, std::min(tuned.threads, plan.threadsPerWorker));
+            }
+            if (plan.engine.kind == EngineConfig::Kind::OnnxRuntime) {
+                plan.engine.intraOpThreads = plan.threadsPerWorker;
+            }
+            plan.autotuned = true;
+        }
+    }
+    return plan;
+}
+
+EngineConfig ImageProcessor::engineConfig(const YoloParams& params, int threadsPerWorker) {
+    EngineConfig config;
+
+    if (params.engine == EngineConfig::Kind::OnnxRuntime && !params.useCUDA) {
+        config.kind = EngineConfig::Kind::OnnxRuntime;
+        // Каждый воркер владеет своей сессией: ее пул потоков делит ядра так же,
+        // как cv::setNumThreads для OpenCV DNN
+        config.intraOpThreads = params.ortIntraOpThreads > 0 ? params.ortIntraOpThreads : threadsPerWorker;
+        config.interOpThreads = std::max(1, params.ortInterOpThreads);
+        config.graphOptimizationLevel = params.ortGraphOptimizationLevel;
+        return config;
+    }
+
+    config.kind = EngineConfig::Kind::OpenCvDnn;
+    if (params.useCUDA) {
+        config.backend = cv::dnn::DNN_BACKEND_CUDA;
+        config.target = cv::dnn::DNN_TARGET_CUDA;
+    } else {
+        config.backend = cv::dnn::DNN_BACKEND_OPENCV;
+        config.target = cv::dnn::DNN_TARGET_CPU;
+    }
+    return config;
+}
+
+std::vector<ImageProcessor::ImageResult> ImageProcessor::processBatch(const QStringList& batchPaths,
+                                                                       const YoloParams& params,
+                                                                       ModelRegistry::Lease& lease) {
+    const int count = batchPaths.size();
+    std::vector<ImageResult> results(count);
+
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
+    // Decode each image once; the same Mat feeds inference, scale detection and crops.
+    // With the result cache on, the file bytes are read once for both the key and the decode.
+    // Retaining candidates needs them for every image, so post-NMS entries are not used then
+    const bool retain = params.retainCandidates;
+    const bool useCache = !m_modelHash.isEmpty() && (!retain || params.spillCandidates);
+    const QByteArray fingerprint = useCache
+        ? cacheFingerprint(params, m_engine, resolveInputSize(lease, params), retain) : QByteArray();
+    std::vector<cv::Mat> images;
+    QStringList imagePaths;
+    std::vector<int> slots;
+    std::vector<QByteArray> cacheKeys;
+    int cacheHits = 0;
+    for (int k = 0; k < count; ++k) {
+        const QString& path = batchPaths[k];
+        LOG_DEBUG(QString("Processing image: %1").arg(path));
+
+        cv::Mat src;
+        QByteArray cacheKey;
+        if (useCache) {
+            QFile file(path);
+            if (file.open(QIODevice::ReadOnly)) {
+                QByteArray data = file.readAll();
+                cacheKey = ResultCache::makeKey(data, m_modelHash, fingerprint);
+                cv::Mat buffer(1, data.size(), CV_8UC1, data.data());
+                src = cv::imdecode(buffer, cv::IMREAD_COLOR);
+            }
+        }
+        if (src.empty()) {
+            src = loadImageSafely(path);
+        }
+        if (src.empty()) {
+            LOG_ERROR(QString("Failed to process %1: Failed to load image").arg(path));
+            results[k].error = QString("Error processing %1: Failed to load image").arg(path);
+            continue;
+        }
+
+        std::vector<CachedDetection> cached;
+        CandidateSet candidates;
+        const bool hit = !cacheKey.isEmpty() &&
+            (retain ? ResultCache::instance().lookupCandidates(cacheKey, candidates)
+                    : ResultCache::instance().lookup(cacheKey, cached));
+        if (hit) {
+            try {
+                double umPerPixel = detectAndCalculateScale(src);
+                QVector<Cell> detectedCells = retain ? cellsFromCandidates(candidates, path, params)
+                                                     : cellsFromCache(cached, src.size(), path, params);
+                results[k].cells = finalizeCells(src, path, detectedCells, umPerPixel,
+                                                 params.cellCrops);
+                if (retain) {
+                    results[k].retained = retainImage(path, umPerPixel, std::move(candidates));
+                }
+                LOG_INFO(QString("Result cache hit: %1 cells in %2").arg(results[k].cells.size()).arg(path));
+            } catch (const std::exception& e) {
+                LOG_ERROR(QString("Failed to process %1: %2").arg(path).arg(e.what()));
+                results[k].error = QString("Error processing %1: %2").arg(path).arg(e.what());
+            }
+            ++cacheHits;
+            continue;
+        }
+
+        images.push_back(src);
+        imagePaths.append(path);
+        slots.push_back(k);
+        cacheKeys.push_back(cacheKey);
+    }
+    qint64 decodeMs = stageTimer.restart();
+
+    if (images.empty()) {
+        if (cacheHits > 0) {
+            LOG_INFO(QString("Timing (%1 images): all from result cache, %2 ms").arg(cacheHits).arg(decodeMs));
+        }
+        return results;
+    }
+
+    std::vector<QVector<Cell>> detected;
+    std::vector<CandidateSet> candidateSets;
+    try {
+        detected = detectCellsWithONNX(images, imagePaths, params, lease, retain ? &candidateSets : nullptr);
+    } catch (const std::exception& e) {
+        for (int k : slots) {
+            LOG_ERROR(QString("Failed to process %1: %2").arg(batchPaths[k]).arg(e.what()));
+            results[k].error = QString("Error processing %1: %2").arg(batchPaths[k]).arg(e.what());
+        }
+        return results;
+    }
+    qint64 inferenceMs = stageTimer.restart();
+
+    for (size_t j = 0; j < images.size(); ++j) {
+        if (!cacheKeys[j].isEmpty()) {
+            if (retain) {
+                ResultCache::instance().storeCandidates(cacheKeys[j], candidateSets[j]);
+            } else {
+                ResultCache::instance().store(cacheKeys[j], toCachedDetections(detected[j]));
+            }
+        }
+
+        ImageResult& result = results[slots[j]];
+        try {
+            double umPerPixel = detectAndCalculateScale(images[j]);
+            result.cells = finalizeCells(images[j], imagePaths[j], detected[j], umPerPixel,
+                                         params.cellCrops);
+            if (retain) {
+                result.retained = retainImage(imagePaths[j], umPerPixel, std::move(candidateSets[j]));
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR(QString("Failed to process %1: %2").arg(imagePaths[j]).arg(e.what()));
+            result.error = QString("Error processing %1: %2").arg(imagePaths[j]).arg(e.what());
+        }
     }
+    qint64 finalizeMs = stageTimer.elapsed();
+
+    LOG_INFO(QString("Timing (%1 images, %2 from result cache): decode %3 ms, inference %4 ms, scale+crops %5 ms")
+        .arg(count).arg(cacheHits).arg(decodeMs).arg(inferenceMs).arg(finalizeMs));
+
+    return results;
+}
 
-    // Detect cells with ONNX
-    QVector<Cell> detectedCells = detectCellsWithONNX(path, params);
+std::shared_ptr<ImageProcessor::RetainedImage> ImageProcessor::retainImage(const QString& path, double umPerPixel,
+                                                                           CandidateSet candidates) {
+    auto retained = std::make_shared<RetainedImage>();
+    retained->path = path;
+    retained->umPerPixel = umPerPixel;
+    retained->candidates = std::move(candidates);
+    return retained;
+}
 
+QVector<Cell> ImageProcessor::finalizeCells(const cv::Mat& src, const QString& path,
+                                            QVector<Cell> detectedCells, double umPerPixel,
+                                            bool withCrops) {
     LOG_DEBUG(QString("Detected %1 cells").arg(detectedCells.size()));
 
-    // Detect scale for μm conversion
-    double umPerPixel = detectAndCalculateScale(src);
+    // Scale for μm conversion (detectAndCalculateScale, 0 = not found)
     if (umPerPixel > 0) {
         LOG_INFO(QString("Scale detected: %1 μm/pixel").arg(umPerPixel));
     }
 
-    // Apply scale and create cell images
+    // Apply scale and create cell images. Each crop is a small owned copy: a ROI
+    // view would keep the whole decoded image alive as long as any of its cells
     for (Cell& cell : detectedCells) {
         // Apply scale if detected
         if (umPerPixel > 0) {
@@ -65,6 +540,10 @@ void ImageProcessor::processSingleImage(const QString& path, const YoloParams& p
             cell.diameter_um = cell.diameter_pixels * umPerPixel;
         }
 
+        if (!withCrops) {
+            continue;
+        }
+
         // Create cell image (crop from original with padding)
         int padding = 30;
         int x = cell.center_x;
@@ -80,13 +559,10 @@ void ImageProcessor::processSingleImage(const QString& path, const YoloParams& p
         if (roiW > 0 && roiH > 0) {
             cv::Rect rectForCrop(roiX, roiY, roiW, roiH);
             cell.image = src(rectForCrop).clone();
-            cell.cellImage = cell.image.clone();
         }
-
-        cells.append(cell);
     }
 
-    if (m_debugMode) {
+    if (m_debugMode && !src.empty()) {
         cv::Mat srcCopy = src.clone();
         for (const Cell& cell : detectedCells) {
             // Draw circle on debug image
@@ -97,271 +573,466 @@ void ImageProcessor::processSingleImage(const QString& path, const YoloParams& p
         cv::imwrite(debugPath, srcCopy);
         LOG_DEBUG(QString("Debug image saved: %1").arg(QString::fromStdString(debugPath)));
     }
-}
-
-QVector<Cell> ImageProcessor::detectCellsWithONNX(const QString& imagePath, const YoloParams& params) {
-    QVector<Cell> detectedCells;
 
-    // Find model path - try multiple locations
-    QString appDir = QCoreApplication::applicationDirPath();
-    QString modelPath;
+    return detectedCells;
+}
 
-    QStringList modelSearchPaths = {
-        QDir(appDir).filePath(params.modelPath),
-        QDir(appDir).filePath("../" + params.modelPath),
-        QDir(appDir).filePath("../../" + params.modelPath),
-        params.modelPath,
-        QString("cell-analyzer/%1").arg(params.modelPath)
-    };
+std::vector<QVector<Cell>> ImageProcessor::detectCellsWithONNX(const std::vector<cv::Mat>& images,
+                                                               const QStringList& imagePaths,
+                                                               const YoloParams& params,
+                                                               ModelRegistry::Lease& lease,
+                                                               std::vector<CandidateSet>* retained) {
+    std::vector<QVector<Cell>> detected(images.size());
+    const float scoreFloor = retained ? candidateFloor(params) : static_cast<float>(params.confThreshold);
+    if (retained) {
+        retained->assign(images.size(), CandidateSet());
+    }
 
-    for (const QString& path : modelSearchPaths) {
-        if (QFile::exists(path)) {
-            modelPath = QFileInfo(path).absoluteFilePath();
-            LOG_DEBUG(QString("Found ONNX model at: %1").arg(modelPath));
-            break;
+    if (params.tiledMode) {
+        for (size_t k = 0; k < images.size(); ++k) {
+            CandidateSet candidates = collectTiledCandidates(images[k], params, lease, scoreFloor);
+            detected[k] = cellsFromCandidates(candidates, imagePaths[k], params);
+            if (retained) {
+                (*retained)[k] = std::move(candidates);
+            }
+            LOG_INFO(QString("ONNX detected %1 cells in %2 (tiled)").arg(detected[k].size()).arg(imagePaths[k]));
         }
+        return detected;
     }
 
-    if (modelPath.isEmpty() || !QFile::exists(modelPath)) {
-        LOG_ERROR(QString("ONNX model not found. Searched in:"));
-        for (const QString& path : modelSearchPaths) {
-            LOG_ERROR(QString("  - %1").arg(path));
+    const cv::Size inputSize = resolveInputSize(lease, params);
+    forwardBatched(images, inputSize, lease, [&](size_t k, const HeadOutput& output, const LetterboxInfo& letterbox) {
+        const YoloDecoder& decoder = lease.decoder(output.detections, letterbox.inputSize);
+        CandidateSet candidates = collectCandidates(output, letterbox, decoder, params, scoreFloor);
+        detected[k] = cellsFromCandidates(candidates, imagePaths[k], params);
+        if (retained) {
+            // Прототипы - представление выхода движка, перезаписываемого следующим forward
+            candidates.protos = candidates.protos.clone();
+            (*retained)[k] = std::move(candidates);
         }
-        throw std::runtime_error("ONNX model not found");
-    }
+        LOG_INFO(QString("ONNX detected %1 cells in %2").arg(detected[k].size()).arg(imagePaths[k]));
+    });
 
-    LOG_INFO(QString("Loading ONNX model: %1").arg(modelPath));
+    return detected;
+}
 
-    // Load ONNX model
-    cv::dnn::Net net;
-    try {
-        net = cv::dnn::readNetFromONNX(modelPath.toStdString());
-    } catch (const cv::Exception& e) {
-        LOG_ERROR(QString("Failed to load ONNX model: %1").arg(e.what()));
-        throw std::runtime_error("Failed to load ONNX model: " + std::string(e.what()));
+CandidateSet ImageProcessor::collectTiledCandidates(const cv::Mat& image, const YoloParams& params,
+                                                   ModelRegistry::Lease& lease, float scoreFloor) {
+    const cv::Size imageSize = image.size();
+    const cv::Size inputSize = resolveInputSize(lease, params);
+    const int tileSize = params.tileSize > 0 ? params.tileSize : inputSize.width;
+    std::vector<cv::Rect> grid = computeTileGrid(imageSize, tileSize, params.tileOverlap);
+
+    LOG_INFO(QString("Tiled inference: %1x%2 image -> %3 tiles of %4 px (overlap %5)")
+        .arg(imageSize.width).arg(imageSize.height).arg(grid.size())
+        .arg(tileSize).arg(params.tileOverlap));
+
+    // Тайлы - ROI-представления исходного Mat, без копирования пикселей
+    std::vector<cv::Mat> tiles;
+    tiles.reserve(grid.size());
+    for (const cv::Rect& tile : grid) {
+        tiles.push_back(image(tile));
     }
 
-    // Set backend and target
-    if (params.useCUDA) {
-        LOG_INFO("Using CUDA backend");
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
-    } else {
-        LOG_INFO("Using CPU backend");
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    CandidateSet result;
+    result.scoreFloor = scoreFloor;
+    result.imageSize = imageSize;
+    result.tiled = true;
+    const size_t chunk = static_cast<size_t>(std::max(1, params.tileBatchSize));
+
+    for (size_t first = 0; first < tiles.size(); first += chunk) {
+        size_t count = std::min(chunk, tiles.size() - first);
+        std::vector<cv::Mat> chunkTiles(tiles.begin() + first, tiles.begin() + first + count);
+
+        forwardBatched(chunkTiles, inputSize, lease,
+                       [&](size_t k, const HeadOutput& output, const LetterboxInfo& letterbox) {
+            const size_t tileIndex = first + k;
+            const cv::Rect& tile = grid[tileIndex];
+
+            // Декодируем в координатах тайла, затем переносим в координаты исходного изображения
+            // Маски в тайловом режиме не декодируются: клетка на шве собирается из рамок
+            Candidates candidates = decodeCandidates(output.detections, letterbox,
+                                                     lease.decoder(output.detections, letterbox.inputSize),
+                                                     scoreFloor);
+            for (size_t i = 0; i < candidates.boxes.size(); ++i) {
+                cv::Rect box = candidates.boxes[i] + tile.tl();
+                result.boxes.push_back(box);
+                result.scores.push_back(candidates.scores[i]);
+                result.classIds.push_back(candidates.classIds[i]);
+                result.tileIndices.push_back(static_cast<int>(tileIndex));
+                result.seams.push_back(tileSeamFlags(box, tile, imageSize));
+            }
+        });
     }
 
-    // Load and preprocess image
-    cv::Mat srcImage = loadImageSafely(imagePath);
-    if (srcImage.empty()) {
-        throw std::runtime_error("Failed to load image for ONNX inference");
-    }
+    return result;
+}
 
-    LOG_DEBUG(QString("Image size: %1x%2").arg(srcImage.cols).arg(srcImage.rows));
+void ImageProcessor::forwardBatched(const std::vector<cv::Mat>& images, const cv::Size& inputSize,
+                                    ModelRegistry::Lease& lease,
+                                    const ForwardConsumer& consume) {
+    DetectorEngine& engine = lease.engine();
+
+    // Batched path: N letterboxed images in one forward, output [N, features, anchors].
+    // Outputs share memory with the engine, so each slice is consumed before the next forward.
+    if (images.size() > 1 && lease.batchMode() != ModelRegistry::BatchMode::Fixed) {
+        const int n = static_cast<int>(images.size());
+        std::vector<LetterboxInfo> letterboxes;
+        HeadOutput output;
+        bool batched = false;
+        try {
+            output = runForward(engine, preprocessBatch(images, inputSize, letterboxes));
+            batched = output.detections.dims == 3 && output.detections.size[0] == n &&
+                      (output.protos.empty() || output.protos.size[0] == n);
+            if (!batched) {
+                LOG_WARNING(QString("Batched forward returned unexpected shape for %1 inputs").arg(n));
+            }
+        } catch (const std::exception& e) {
+            LOG_WARNING(QString("Batched forward failed: %1").arg(e.what()));
+        }
 
-    // Preprocess image for YOLOv8 (640x640, normalized)
-    cv::Mat blob = preprocessImage(srcImage);
+        if (batched) {
+            if (lease.batchMode() == ModelRegistry::BatchMode::Unknown) {
+                LOG_INFO("ONNX model accepts dynamic batch size");
+                lease.setBatchMode(ModelRegistry::BatchMode::Dynamic);
+            }
+            for (size_t k = 0; k < images.size(); ++k) {
+                HeadOutput slice;
+                slice.detections = batchSlice(output.detections, static_cast<int>(k));
+                if (!output.protos.empty()) {
+                    slice.protos = batchSlice(output.protos, static_cast<int>(k));
+                }
+                consume(k, slice, letterboxes[k]);
+            }
+            return;
+        }
 
-    // Run inference
-    net.setInput(blob);
-    std::vector<cv::Mat> outputs;
-    net.forward(outputs, net.getUnconnectedOutLayersNames());
+        LOG_INFO("ONNX model has a fixed batch size, falling back to one image per forward");
+        lease.setBatchMode(ModelRegistry::BatchMode::Fixed);
+    }
 
-    LOG_DEBUG(QString("ONNX inference completed, outputs: %1").arg(outputs.size()));
+    for (size_t k = 0; k < images.size(); ++k) {
+        LOG_DEBUG(QString("Image size: %1x%2").arg(images[k].cols).arg(images[k].rows));
 
-    if (outputs.empty()) {
-        LOG_ERROR("No outputs from ONNX model");
-        return detectedCells;
+        // Preprocess image for YOLOv8 (letterbox to the model input, normalized)
+        LetterboxInfo letterbox;
+        HeadOutput output = runForward(engine, preprocessImage(images[k], inputSize, letterbox));
+        if (output.detections.empty()) {
+            LOG_ERROR("No outputs from ONNX model");
+            continue;
+        }
+
+        consume(k, output, letterbox);
     }
+}
 
-    // Postprocess results
-    detectedCells = postprocessONNX(outputs[0], srcImage, imagePath, params);
+ImageProcessor::HeadOutput ImageProcessor::runForward(DetectorEngine& engine, const cv::Mat& blob) {
+    std::vector<cv::Mat> outputs = engine.infer(blob);
 
-    LOG_INFO(QString("ONNX detected %1 cells in %2").arg(detectedCells.size()).arg(imagePath));
+    LOG_DEBUG(QString("ONNX inference completed, outputs: %1").arg(outputs.size()));
 
-    return detectedCells;
+    // Порядок выходов зависит от экспорта: детекции - 3D, прототипы масок - 4D
+    HeadOutput result;
+    for (const cv::Mat& output : outputs) {
+        if (output.dims == 3 && result.detections.empty()) {
+            result.detections = output;
+        } else if (output.dims == 4 && result.protos.empty()) {
+            result.protos = output;
+        }
+    }
+    if (result.detections.empty() && !outputs.empty()) {
+        result.detections = outputs[0];
+    }
+    return result;
 }
 
-cv::Mat ImageProcessor::preprocessImage(const cv::Mat& image) {
-    // YOLOv8 expects 640x640 input
-    int inputWidth = 640;
-    int inputHeight = 640;
+cv::Mat ImageProcessor::batchSlice(const cv::Mat& output, int index) {
+    // View of one image in a [N, ...] output as [1, ...], without copying
+    std::vector<int> sliceShape(output.size.p, output.size.p + output.dims);
+    sliceShape[0] = 1;
+    return cv::Mat(output.dims, sliceShape.data(), CV_32F, const_cast<float*>(output.ptr<float>(index)));
+}
 
-    cv::Mat resized;
-    cv::resize(image, resized, cv::Size(inputWidth, inputHeight));
+cv::Mat ImageProcessor::preprocessImage(const cv::Mat& image, const cv::Size& inputSize,
+                                        LetterboxInfo& letterbox) {
+    std::vector<LetterboxInfo> letterboxes;
+    cv::Mat blob = preprocessBatch(std::vector<cv::Mat>{image}, inputSize, letterboxes);
+    letterbox = letterboxes.front();
+    return blob;
+}
 
-    // Convert BGR to RGB and normalize to [0, 1]
-    cv::Mat rgb;
-    cv::cvtColor(resized, rgb, cv::COLOR_BGR2RGB);
+cv::Mat ImageProcessor::preprocessBatch(const std::vector<cv::Mat>& images, const cv::Size& inputSize,
+                                        std::vector<LetterboxInfo>& letterboxes) {
+    // YOLOv8 expects RGB input scaled to [0, 1]; letterbox keeps the aspect ratio.
+    // The blob lives in a per-thread buffer reused by the next call on this worker.
+    return letterboxBlob(images, inputSize, letterboxes);
+}
 
-    // Create blob: convert to float, normalize, and transpose to NCHW format
-    cv::Mat blob = cv::dnn::blobFromImage(rgb, 1.0 / 255.0, cv::Size(inputWidth, inputHeight),
-                                          cv::Scalar(0, 0, 0), true, false);
+cv::Size ImageProcessor::resolveInputSize(const ModelRegistry::Lease& lease, const YoloParams& params) {
+    // A size declared in the model graph wins; dynamic exports take it from params
+    cv::Size modelSize = lease.modelInputSize();
+    if (!modelSize.empty()) {
+        if (params.inputSize > 0 && params.inputSize != modelSize.width) {
+            LOG_WARNING(QString("Model input is fixed at %1x%2, ignoring inputSize=%3")
+                .arg(modelSize.width).arg(modelSize.height).arg(params.inputSize));
+        }
+        return modelSize;
+    }
 
-    return blob;
+    // YOLO strides require a multiple of 32
+    int size = params.inputSize > 0 ? params.inputSize : 640;
+    size = std::max(32, (size + 31) / 32 * 32);
+    return cv::Size(size, size);
 }
 
-QVector<Cell> ImageProcessor::postprocessONNX(const cv::Mat& output, const cv::Mat& originalImage,
-                                               const QString& imagePath, const YoloParams& params) {
-    QVector<Cell> detectedCells;
+CandidateSet ImageProcessor::collectCandidates(const HeadOutput& output, const LetterboxInfo& letterbox,
+                                              const YoloDecoder& decoder, const YoloParams& params,
+                                              float scoreFloor) {
+    Candidates decoded = decodeCandidates(output.detections, letterbox, decoder, scoreFloor);
+
+    CandidateSet candidates;
+    candidates.scoreFloor = scoreFloor;
+    candidates.imageSize = letterbox.sourceSize;
+    candidates.letterbox = letterbox;
+    if (params.decodeMasks && decoder.head.maskCoeffs > 0 && !output.protos.empty()) {
+        candidates.maskCoefficients = gatherMaskCoefficients(output.detections, decoder.head, decoded.anchors);
+        candidates.protos = output.protos;
+    }
+    candidates.boxes = std::move(decoded.boxes);
+    candidates.scores = std::move(decoded.scores);
+    candidates.classIds = std::move(decoded.classIds);
+    return candidates;
+}
 
-    // Check output dimensions
-    if (output.dims != 3) {
-        LOG_ERROR(QString("Invalid output dimensions: %1").arg(output.dims));
-        return detectedCells;
-    }
-
-    int batchSize = output.size[0];
-    int dim1 = output.size[1];
-    int dim2 = output.size[2];
-
-    LOG_INFO(QString("Output shape: [%1, %2, %3]").arg(batchSize).arg(dim1).arg(dim2));
-    LOG_INFO(QString("Image size: %1x%2").arg(originalImage.cols).arg(originalImage.rows));
-
-    // Determine output format
-    // YOLOv8 can be: [1, 84, 8400] or [1, 8400, 84] or [1, 38, 8400] for custom models
-    int numFeatures, numDetections;
-
-    if (dim2 == 8400) {
-        // Format: [1, features, 8400] - NON-transposed (old format)
-        numFeatures = dim1;
-        numDetections = dim2;
-        LOG_INFO(QString("Detected NON-transposed format: [1, %1, %2]").arg(numFeatures).arg(numDetections));
-    } else if (dim1 == 8400) {
-        // Format: [1, 8400, features] - transposed (new format)
-        numDetections = dim1;
-        numFeatures = dim2;
-        LOG_INFO(QString("Detected transposed format: [1, %1, %2]").arg(numDetections).arg(numFeatures));
-    } else {
-        LOG_ERROR(QString("Unknown output format: [%1, %2, %3]").arg(batchSize).arg(dim1).arg(dim2));
-        return detectedCells;
+QVector<Cell> ImageProcessor::cellsFromCandidates(const CandidateSet& candidates, const QString& imagePath,
+                                                  const YoloParams& params) {
+    // Retained candidates may go below confThreshold (down to candidateFloor)
+    const float confThreshold = static_cast<float>(params.confThreshold);
+    std::vector<int> passing;
+    passing.reserve(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates.scores[i] >= confThreshold) {
+            passing.push_back(static_cast<int>(i));
+        }
     }
 
-    // Calculate scale factors from 640x640 to original image size
-    float scaleX = (float)originalImage.cols / 640.0f;
-    float scaleY = (float)originalImage.rows / 640.0f;
+    if (candidates.tiled) {
+        std::vector<TileDetection> tileDetections;
+        tileDetections.reserve(passing.size());
+        for (int i : passing) {
+            TileDetection det;
+            det.box = candidates.boxes[i];
+            det.score = candidates.scores[i];
+            det.classId = candidates.classIds[i];
+            det.tileIndex = candidates.tileIndices[i];
+            det.seams = candidates.seams[i];
+            tileDetections.push_back(det);
+        }
 
-    LOG_INFO(QString("Scale factors: scaleX=%1, scaleY=%2").arg(scaleX).arg(scaleY));
+        std::vector<TileDetection> merged = mergeTileDetections(tileDetections, nmsOptions(params));
+        LOG_INFO(QString("Tiled merge: %1 tile detections -> %2").arg(tileDetections.size()).arg(merged.size()));
+
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        std::vector<int> classIds;
+        boxes.reserve(merged.size());
+        scores.reserve(merged.size());
+        classIds.reserve(merged.size());
+        for (const TileDetection& det : merged) {
+            boxes.push_back(det.box);
+            scores.push_back(det.score);
+            classIds.push_back(det.classId);
+        }
 
-    std::vector<cv::Rect> boxes;
-    std::vector<float> confidences;
-
-    // Parse detections based on format
-    int loggedCount = 0;
-    if (dim2 == 8400) {
-        // NON-transposed: [1, features, 8400]
-        // Need to access as [0, feature_idx, detection_idx]
-        // For YOLOv8-seg: indices 0-3 = bbox, 4-5 = class scores (2 classes), 6-37 = mask coefficients (32)
-        for (int i = 0; i < numDetections; i++) {
-            // Get bbox coordinates
-            float xCenter = output.at<float>(0, 0, i);
-            float yCenter = output.at<float>(0, 1, i);
-            float w = output.at<float>(0, 2, i);
-            float h = output.at<float>(0, 3, i);
-
-            // Get class score(s)
-            // IMPORTANT: For YOLOv8-seg with 2 classes, indices 4-5 are class scores, rest are mask coefficients
-            // We only check the first 2 class scores (indices 4-5)
-            float maxScore = 0.0f;
-            int numClasses = std::min(2, numFeatures - 4);  // Only use first 2 scores for classes
-
-            for (int j = 0; j < numClasses; j++) {
-                float score = output.at<float>(0, 4 + j, i);
-                if (score > maxScore) {
-                    maxScore = score;
-                }
-            }
+        return buildCells(boxes, scores, classIds, {}, candidates.imageSize, imagePath, params);
+    }
 
-            // Log first few detections for debugging
-            if (loggedCount < 5 && maxScore > 0.01) {
-                LOG_INFO(QString("Detection %1: x=%2, y=%3, w=%4, h=%5, score=%6")
-                    .arg(i).arg(xCenter).arg(yCenter).arg(w).arg(h).arg(maxScore));
-                loggedCount++;
-            }
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    std::vector<int> classIds;
+    boxes.reserve(passing.size());
+    scores.reserve(passing.size());
+    classIds.reserve(passing.size());
+    for (int i : passing) {
+        boxes.push_back(candidates.boxes[i]);
+        scores.push_back(candidates.scores[i]);
+        classIds.push_back(candidates.classIds[i]);
+    }
 
-            // Filter by confidence threshold
-            if (maxScore < params.confThreshold) {
-                continue;
-            }
+    LOG_INFO(QString("Before NMS: %1 detections").arg(boxes.size()));
 
-            // Convert from center format to corner format and scale to original image
-            float x1 = (xCenter - w / 2.0f) * scaleX;
-            float y1 = (yCenter - h / 2.0f) * scaleY;
-            float x2 = (xCenter + w / 2.0f) * scaleX;
-            float y2 = (yCenter + h / 2.0f) * scaleY;
+    std::vector<int> indices = nonMaxSuppression(boxes, scores, classIds, nmsOptions(params));
 
-            // Clamp to image boundaries
-            x1 = std::max(0.0f, std::min(x1, (float)originalImage.cols - 1));
-            y1 = std::max(0.0f, std::min(y1, (float)originalImage.rows - 1));
-            x2 = std::max(0.0f, std::min(x2, (float)originalImage.cols));
-            y2 = std::max(0.0f, std::min(y2, (float)originalImage.rows));
+    LOG_INFO(QString("After NMS: %1 detections").arg(indices.size()));
 
-            int width = static_cast<int>(x2 - x1);
-            int height = static_cast<int>(y2 - y1);
+    std::vector<cv::Rect> keptBoxes;
+    std::vector<float> keptScores;
+    std::vector<int> keptRows;
+    std::vector<int> keptClasses;
+    for (int idx : indices) {
+        if (boxes[idx].area() < params.minCellArea) {
+            continue;
+        }
+        keptBoxes.push_back(boxes[idx]);
+        keptScores.push_back(scores[idx]);
+        keptRows.push_back(passing[idx]);
+        keptClasses.push_back(classIds[idx]);
+    }
 
-            if (width > 0 && height > 0) {
-                boxes.push_back(cv::Rect(static_cast<int>(x1), static_cast<int>(y1), width, height));
-                confidences.push_back(maxScore);
-            }
+    // Маски считаются только для оставшихся детекций
+    std::vector<InstanceMask> masks;
+    if (!candidates.maskCoefficients.empty() && !candidates.protos.empty() && !keptRows.empty()) {
+        cv::Mat coefficients(static_cast<int>(keptRows.size()), candidates.maskCoefficients.cols, CV_32F);
+        for (size_t k = 0; k < keptRows.size(); ++k) {
+            candidates.maskCoefficients.row(keptRows[k]).copyTo(coefficients.row(static_cast<int>(k)));
         }
-    } else {
-        // Transposed: [1, 8400, features]
-        // For YOLOv8-seg: indices 0-3 = bbox, 4-5 = class scores (2 classes), 6-37 = mask coefficients (32)
-        for (int i = 0; i < numDetections; i++) {
-            const float* detection = output.ptr<float>(0, i);
-
-            float xCenter = detection[0];
-            float yCenter = detection[1];
-            float w = detection[2];
-            float h = detection[3];
-
-            float maxScore = 0.0f;
-            int numClasses = std::min(2, numFeatures - 4);  // Only use first 2 scores for classes
-
-            for (int j = 0; j < numClasses; j++) {
-                float score = detection[4 + j];
-                if (score > maxScore) {
-                    maxScore = score;
-                }
-            }
+        masks = decodeInstanceMasks(candidates.protos, coefficients, keptBoxes, candidates.letterbox);
+    }
 
-            if (maxScore < params.confThreshold) {
-                continue;
-            }
+    return buildCells(keptBoxes, keptScores, keptClasses, masks, candidates.imageSize, imagePath, params);
+}
 
-            float x1 = (xCenter - w / 2.0f) * scaleX;
-            float y1 = (yCenter - h / 2.0f) * scaleY;
-            float x2 = (xCenter + w / 2.0f) * scaleX;
-            float y2 = (yCenter + h / 2.0f) * scaleY;
+NmsOptions ImageProcessor::nmsOptions(const YoloParams& params) {
+    NmsOptions options;
+    options.iouThreshold = static_cast<float>(params.iouThreshold);
+    options.topK = params.nmsTopK;
+    options.classAware = params.classAwareNms;
+    return options;
+}
 
-            x1 = std::max(0.0f, std::min(x1, (float)originalImage.cols - 1));
-            y1 = std::max(0.0f, std::min(y1, (float)originalImage.rows - 1));
-            x2 = std::max(0.0f, std::min(x2, (float)originalImage.cols));
-            y2 = std::max(0.0f, std::min(y2, (float)originalImage.rows));
+ImageProcessor::Candidates ImageProcessor::decodeCandidates(const cv::Mat& output, const LetterboxInfo& letterbox,
+                                                            const YoloDecoder& decoder, float scoreThreshold) {
+    Candidates candidates;
+    const cv::Size& imageSize = letterbox.sourceSize;
 
-            int width = static_cast<int>(x2 - x1);
-            int height = static_cast<int>(y2 - y1);
+    if (!decoder.isValid()) {
+        if (output.dims == 3) {
+            LOG_ERROR(QString("Unknown output format: [%1, %2, %3]")
+                .arg(output.size[0]).arg(output.size[1]).arg(output.size[2]));
+        } else {
+            LOG_ERROR(QString("Invalid output dimensions: %1").arg(output.dims));
+        }
+        return candidates;
+    }
 
-            if (width > 0 && height > 0) {
-                boxes.push_back(cv::Rect(static_cast<int>(x1), static_cast<int>(y1), width, height));
-                confidences.push_back(maxScore);
-            }
+    static thread_local AnchorCandidates anchors;
+    decoder.decode(output, scoreThreshold, anchors);
+
+    candidates.boxes.reserve(anchors.size());
+    candidates.scores.reserve(anchors.size());
+    for (size_t i = 0; i < anchors.size(); ++i) {
+        const cv::Vec4f& b = anchors.boxes[i];
+
+        // Convert from center format to corner format and undo the letterbox
+        float x1 = letterbox.toSourceX(b[0] - b[2] / 2.0f);
+        float y1 = letterbox.toSourceY(b[1] - b[3] / 2.0f);
+        float x2 = letterbox.toSourceX(b[0] + b[2] / 2.0f);
+        float y2 = letterbox.toSourceY(b[1] + b[3] / 2.0f);
+
+        // Clamp to image boundaries
+        x1 = std::max(0.0f, std::min(x1, (float)imageSize.width - 1));
+        y1 = std::max(0.0f, std::min(y1, (float)imageSize.height - 1));
+        x2 = std::max(0.0f, std::min(x2, (float)imageSize.width));
+        y2 = std::max(0.0f, std::min(y2, (float)imageSize.height));
+
+        int width = static_cast<int>(x2 - x1);
+        int height = static_cast<int>(y2 - y1);
+
+        if (width > 0 && height > 0) {
+            candidates.boxes.push_back(cv::Rect(static_cast<int>(x1), static_cast<int>(y1), width, height));
+            candidates.scores.push_back(anchors.scores[i]);
+            candidates.anchors.push_back(anchors.anchors[i]);
+            candidates.classIds.push_back(anchors.classIds[i]);
         }
     }
 
-    LOG_INFO(QString("Before NMS: %1 detections").arg(boxes.size()));
+    return candidates;
+}
+
+std::string ImageProcessor::yoloClassName(int classId) {
+    // Classes of the cell segmentation model (ml-data/README.md)
+    switch (classId) {
+    case 0: return "cell";
+    case 1: return "droplet";
+    default: return "class " + std::to_string(classId);
+    }
+}
+
+QByteArray ImageProcessor::cacheFingerprint(const YoloParams& params, const EngineConfig& engine,
+                                            const cv::Size& inputSize, bool candidates) {
+    // The engine enters by its precision/backend part: FP16 or OpenVINO (possibly picked
+    // by autotune) give slightly different scores. Batching and thread settings are left
+    // out: they change speed, not detections.
+    // Candidate sets do not depend on thresholds applied after decoding, only on the floor
+    QString geometry = QString("engine=%1;input=%2x%3;tiled=%4;tile=%5;overlap=%6;masks=%7")
+        .arg(engine.numericsKey())
+        .arg(inputSize.width).arg(inputSize.height)
+        .arg(params.tiledMode ? 1 : 0).arg(params.tiledMode ? params.tileSize : 0)
+        .arg(params.tiledMode ? params.tileOverlap : 0).arg(params.decodeMasks ? 1 : 0);
+    if (candidates) {
+        return QString("candidates;floor=%1;%2").arg(candidateFloor(params), 0, 'g', 9).arg(geometry).toLatin1();
+    }
+    return QString("conf=%1;iou=%2;minArea=%3;classAware=%4;topK=%5;%6")
+        .arg(params.confThreshold, 0, 'g', 17).arg(params.iouThreshold, 0, 'g', 17)
+        .arg(params.minCellArea).arg(params.classAwareNms ? 1 : 0).arg(params.nmsTopK)
+        .arg(geometry)
+        .toLatin1();
+}
 
-    // Apply Non-Maximum Suppression
-    // Note: We already filtered by confThreshold above, so use 0.0 here to avoid double filtering
-    std::vector<int> indices;
-    cv::dnn::NMSBoxes(boxes, confidences, 0.0f, params.iouThreshold, indices);
+float ImageProcessor::candidateFloor(const YoloParams& params) {
+    return static_cast<float>(std::max(0.0, std::min(params.confThreshold, params.candidateFloor)));
+}
 
-    LOG_INFO(QString("After NMS: %1 detections").arg(indices.size()));
+std::vector<CachedDetection> ImageProcessor::toCachedDetections(const QVector<Cell>& detectedCells) {
+    std::vector<CachedDetection> detections;
+    detections.reserve(detectedCells.size());
+    for (const Cell& cell : detectedCells) {
+        CachedDetection detection;
+        detection.box = cv::Rect(cell.bbox_x, cell.bbox_y, cell.bbox_width, cell.bbox_height);
+        detection.score = cell.confidence;
+        detection.classId = cell.cellType - 1;
+        if (!cell.mask.empty()) {
+            detection.mask.mask = cell.mask;
+            detection.mask.area = cell.area;
+            detection.mask.equivalentDiameter = cell.equivalentDiameter;
+        }
+        detections.push_back(detection);
+    }
+    return detections;
+}
+
+QVector<Cell> ImageProcessor::cellsFromCache(const std::vector<CachedDetection>& detections,
+                                             const cv::Size& imageSize, const QString& imagePath,
+                                             const YoloParams& params) {
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    std::vector<int> classIds;
+    std::vector<InstanceMask> masks;
+    bool classified = true;
+    for (const CachedDetection& detection : detections) {
+        boxes.push_back(detection.box);
+        scores.push_back(detection.score);
+        classIds.push_back(detection.classId);
+        masks.push_back(detection.mask);
+        classified = classified && detection.classId >= 0;
+    }
+    if (!classified) {
+        classIds.clear();  // cellType 0 stays unknown
+    }
+    return buildCells(boxes, scores, classIds, masks, imageSize, imagePath, params);
+}
+
+QVector<Cell> ImageProcessor::buildCells(const std::vector<cv::Rect>& boxes, const std::vector<float>& confidences,
+                                         const std::vector<int>& classIds,
+                                         const std::vector<InstanceMask>& masks,
+                                         const cv::Size& imageSize, const QString& imagePath,
+                                         const YoloParams& params) {
+    QVector<Cell> detectedCells;
+    const int imageId = ImageCatalog::instance().intern(imagePath);
 
     // Create Cell objects
-    for (int idx : indices) {
-        cv::Rect box = boxes[idx];
+    for (size_t idx = 0; idx < boxes.size(); ++idx) {
+        const cv::Rect& box = boxes[idx];
 
         // Calculate area
         int area = box.width * box.height;
@@ -423,8 +1094,8 @@ QVector<Cell> ImageProcessor::postprocessONNX(const cv::Mat& output, const cv::M
         // Log calculation for first few cells or border cells
         if (detectedCells.size() < 3 ||
             bbox_x < radius || bbox_y < radius ||
-            (bbox_x + bbox_width + radius) > originalImage.cols ||
-            (bbox_y + bbox_height + radius) > originalImage.rows) {
+            (bbox_x + bbox_width + radius) > imageSize.width ||
+            (bbox_y + bbox_height + radius) > imageSize.height) {
             LOG_INFO(QString("Cell calculation: bbox(%1,%2,%3,%4) -> diameter=%5, radius=%6, center=(%7,%8)")
                 .arg(bbox_x).arg(bbox_y).arg(bbox_width).arg(bbox_height)
                 .arg(diameter).arg(radius).arg(centerX).arg(centerY));
@@ -442,11 +1113,36 @@ QVector<Cell> ImageProcessor::postprocessONNX(const cv::Mat& output, const cv::M
         cell.bbox_width = bbox_width;
         cell.bbox_height = bbox_height;
         cell.confidence = confidences[idx];
-        cell.imagePath = imagePath.toStdString();
+        if (idx < classIds.size()) {
+            // cellType: 0 = unknown, 1+ = YOLO class id + 1
+            cell.cellType = classIds[idx] + 1;
+            cell.cellTypeName = yoloClassName(classIds[idx]);
+        }
+        cell.imageId = imageId;
         cell.circle = cv::Vec3f(centerX, centerY, radius);
         cell.diameter_um = 0.0;
         cell.diameterNm = 0.0;
 
+        // Segmentation mask: true pixel area and equivalent diameter.
+        // Cells cut by the image border keep the extrapolated bbox diameter.
+        if (idx < masks.size() && !masks[idx].isEmpty()) {
+            const InstanceMask& mask = masks[idx];
+            cell.mask = mask.mask;
+            cell.area = mask.area;
+            cell.equivalentDiameter = mask.equivalentDiameter;
+
+            bool touchesBorder = bbox_x <= 0 || bbox_y <= 0 ||
+                                 bbox_x + bbox_width >= imageSize.width ||
+                                 bbox_y + bbox_height >= imageSize.height;
+            if (!touchesBorder) {
+                int maskDiameter = static_cast<int>(std::lround(mask.equivalentDiameter));
+                cell.diameter_pixels = maskDiameter;
+                cell.diameterPx = static_cast<float>(mask.equivalentDiameter);
+                cell.radius = maskDiameter / 2;
+                cell.circle = cv::Vec3f(centerX, centerY, mask.equivalentDiameter / 2.0);
+            }
+        }
+
         detectedCells.append(cell);
     }
 
@@ -463,30 +1159,26 @@ cv::Mat ImageProcessor::loadImageSafely(const QString& imagePath) {
         }
     }
 
-    // For Unicode paths, use QImage directly to avoid OpenCV warnings
+    // For Unicode paths, read the bytes through QFile and decode with OpenCV:
+    // one decode straight into BGR, no QImage -> RGB888 -> BGR round trip
     if (hasUnicode) {
-        QImage qImage;
-        if (!qImage.load(imagePath)) {
-            LOG_ERROR("Failed to load image: " + imagePath);
-            return cv::Mat();
+        QFile file(imagePath);
+        if (file.open(QIODevice::ReadOnly)) {
+            QByteArray data = file.readAll();
+            file.close();
+            cv::Mat buffer(1, data.size(), CV_8UC1, data.data());
+            cv::Mat image = cv::imdecode(buffer, cv::IMREAD_COLOR);
+            if (!image.empty()) {
+                LOG_DEBUG("Image decoded from memory (Unicode path): " + imagePath);
+                return image;
+            }
+        }
+    } else {
+        // For ASCII paths, try OpenCV directly (faster)
+        cv::Mat image = cv::imread(imagePath.toStdString());
+        if (!image.empty()) {
+            return image;
         }
-
-        // Convert QImage to cv::Mat
-        QImage rgbImage = qImage.convertToFormat(QImage::Format_RGB888);
-        cv::Mat mat(rgbImage.height(), rgbImage.width(), CV_8UC3,
-                   (void*)rgbImage.constBits(), rgbImage.bytesPerLine());
-        cv::Mat result;
-        cv::cvtColor(mat, result, cv::COLOR_RGB2BGR);
-
-        LOG_DEBUG("Image loaded through QImage (Unicode path): " + imagePath);
-        return result.clone();
-    }
-
-    // For ASCII paths, try OpenCV directly (faster)
-    cv::Mat image = cv::imread(imagePath.toStdString());
-
-    if (!image.empty()) {
-        return image;
     }
 
     // Fallback to QImage if OpenCV failed
@@ -500,10 +1192,10 @@ cv::Mat ImageProcessor::loadImageSafely(const QString& imagePath) {
     cv::Mat mat(rgbImage.height(), rgbImage.width(), CV_8UC3,
                (void*)rgbImage.constBits(), rgbImage.bytesPerLine());
     cv::Mat result;
-    cv::cvtColor(mat, result, cv::COLOR_RGB2BGR);
+    cv::cvtColor(mat, result, cv::COLOR_RGB2BGR);  // result owns its own buffer
 
     LOG_INFO("Image loaded through QImage (fallback): " + imagePath);
-    return result.clone();
+    return result;
 }
 
 // Scale detection methods (keep from original implementation)
@@ -6,17 +6,87 @@
 #include <QString>
 #include <QMutex>
 #include "cell.h"
+#include "modelregistry.h"
+#include "letterbox.h"
+#include "maskdecoder.h"
+#include "nms.h"
+#include "resultcache.h"
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <memory>
 
 class ImageProcessor {
 public:
     struct YoloParams {
         QString modelPath = "ml-data/models/yolov8s_cells_v1.0.onnx";
+        // Network input side (320 for previews, 1024/1280 for big slides). Models with
+        // a fixed input shape always use their own; 0 = model shape, or 640 if dynamic.
+        int inputSize = 0;
         double confThreshold = 0.1;  // Lowered from 0.25 to test
         double iouThreshold = 0.7;
         int minCellArea = 500;
         bool useCUDA = false;  // Use CUDA backend if available
+
+        // Parallel batch mode: several images are processed at once, each worker
+        // owns its own network instance. 0 = choose automatically from core count.
+        int workerCount = 0;
+        int threadsPerWorker = 0;  // cv::setNumThreads per worker, 0 = cores / workers
+
+        // Images per forward pass. Models exported with a fixed batch of 1
+        // are detected on first use and fall back to N=1.
+        int batchSize = 1;
+
+        // Inference engine. ONNX Runtime needs a WITH_ONNXRUNTIME build, otherwise
+        // (and with useCUDA) OpenCV DNN is used.
+        EngineConfig::Kind engine = EngineConfig::Kind::OpenCvDnn;
+        int ortIntraOpThreads = 0;           // 0 = threadsPerWorker
+        int ortInterOpThreads = 1;
+        int ortGraphOptimizationLevel = 99;  // 0 off, 1 basic, 2 extended, 99 all
+
+        // Benchmark backend/precision/thread count once per model file and
+        // reuse the persisted winner (see BackendAutotuner). Ignored with useCUDA.
+        bool autotune = false;
+
+        // Tiled mode for high-resolution micrographs: the image is cut into
+        // overlapping tileSize x tileSize windows at native resolution instead of
+        // being downscaled to the model input; detections are merged across tile seams.
+        bool tiledMode = false;
+        int tileSize = 0;        // 0 = model input size
+        int tileOverlap = 160;   // should exceed the largest expected cell diameter
+        int tileBatchSize = 8;   // tiles per forward pass
+
+        // Decode YOLOv8-seg instance masks for cells that survive NMS:
+        // area and diameter come from the mask instead of the bbox
+        bool decodeMasks = true;
+
+        // NMS: boxes of different classes (cell / droplet) do not suppress each
+        // other; only the nmsTopK highest-scoring candidates enter NMS (0 = all)
+        bool classAwareNms = true;
+        int nmsTopK = 5000;
+
+        // Cell::image crops for thumbnails: one small owned copy per cell (~10 KB for a
+        // typical cell), the decoded image is freed after processing; headless export
+        // turns them off
+        bool cellCrops = true;
+
+        // Reuse detections of images seen before with the same model file and
+        // detection parameters (see ResultCache); only misses run inference
+        bool useResultCache = true;
+
+        // Keep the pre-NMS candidates of every image (down to candidateFloor) and its
+        // scale, so rethreshold() re-runs only filtering, NMS and masks for a new
+        // confThreshold / iouThreshold / minCellArea. The decoded image is not kept:
+        // crops are cut from the file decoded again. Costs a few KB of boxes and
+        // scores per image plus, for -seg models, ~3 MB of mask prototypes, until
+        // the next processImages or releaseCandidates().
+        bool retainCandidates = false;
+        double candidateFloor = 0.05;
+        // With retainCandidates: also spill candidate sets to the result cache, so a
+        // later run skips inference for images seen before
+        bool spillCandidates = false;
     };
 
     ImageProcessor();
@@ -25,6 +95,25 @@ public:
     // Main processing function using YOLO
     void processImages(const QStringList& paths, const YoloParams& params = YoloParams());
 
+    // Loads the model into ModelRegistry with the same engine configuration
+    // processImages will use, one instance per worker (loaded concurrently),
+    // and runs a dummy forward on each, so every worker of the first analysis
+    // starts on a ready engine. Thread-safe; meant for a background thread.
+    static bool warmUp(const YoloParams& params = YoloParams(), QString* error = nullptr);
+
+    // Re-runs score filtering, NMS, masks and cell building over the candidates
+    // retained by the last processImages (YoloParams::retainCandidates), for all
+    // retained images or only `paths`, without inference. Only the thresholds may
+    // differ from that run: confThreshold (not below candidateFloor), iouThreshold,
+    // minCellArea, classAwareNms, nmsTopK. Results replace getDetectedCells() and
+    // go through the result/progress callbacks on the calling thread.
+    // Returns false with getLastError() set if the request cannot be served.
+    bool rethreshold(const YoloParams& params, const QStringList& paths = QStringList());
+    bool hasRetainedCandidates(const QString& path = QString()) const;
+    // Candidates above candidateFloor kept for all retained images or only `path`
+    size_t retainedCandidateCount(const QString& path = QString()) const;
+    void releaseCandidates();
+
     // Getters
     QVector<Cell> getDetectedCells() const { return cells; }
     QString getLastError() const;
@@ -32,15 +121,108 @@ public:
     // Configuration
     void setDebugMode(bool enable);
 
+    // Called once per finished image from the worker threads (not the GUI
+    // thread): processed so far, total, image path, cells found in it
+    using ProgressCallback = std::function<void(int processed, int total, const QString& imagePath, int cellCount)>;
+    void setProgressCallback(ProgressCallback callback) { m_progressCallback = std::move(callback); }
+
+    // Streaming results channel: the cells of each image as soon as it is done,
+    // before the progress callback for that image. Same threading as above.
+    using ResultCallback = std::function<void(const QString& imagePath, const QVector<Cell>& cells)>;
+    void setResultCallback(ResultCallback callback) { m_resultCallback = std::move(callback); }
+
+    // Cooperative cancellation from any thread: workers stop claiming new
+    // images, processImages returns with the cells of images already finished.
+    // The flag is sticky: a processor is meant for one analysis run
+    void requestCancel() { m_cancelRequested = true; }
+    bool wasCanceled() const { return m_cancelRequested; }
+
 private:
+    // Everything rethreshold() needs for one image; pixels for crops are
+    // decoded again from path
+    struct RetainedImage {
+        QString path;
+        double umPerPixel = 0.0;
+        CandidateSet candidates;
+    };
+
+    struct ImageResult {
+        QVector<Cell> cells;
+        QString error;
+        std::shared_ptr<RetainedImage> retained;  // only with retainCandidates
+    };
+
     // Processing methods
-    void processSingleImage(const QString& path, const YoloParams& params);
-    QVector<Cell> detectCellsWithONNX(const QString& imagePath, const YoloParams& params);
+    std::vector<ImageResult> processBatch(const QStringList& batchPaths, const YoloParams& params,
+                                          ModelRegistry::Lease& lease);
+    QVector<Cell> finalizeCells(const cv::Mat& src, const QString& path, QVector<Cell> detectedCells,
+                                double umPerPixel, bool withCrops);
+    static std::shared_ptr<RetainedImage> retainImage(const QString& path, double umPerPixel,
+                                                      CandidateSet candidates);
+    // retained: when set, candidates are collected down to candidateFloor and kept per image
+    std::vector<QVector<Cell>> detectCellsWithONNX(const std::vector<cv::Mat>& images,
+                                                   const QStringList& imagePaths,
+                                                   const YoloParams& params,
+                                                   ModelRegistry::Lease& lease,
+                                                   std::vector<CandidateSet>* retained = nullptr);
+    CandidateSet collectTiledCandidates(const cv::Mat& image, const YoloParams& params,
+                                        ModelRegistry::Lease& lease, float scoreFloor);
+
+    // Parallel batch helpers
+    static int resolveWorkerCount(int imageCount, const YoloParams& params);
+    static EngineConfig engineConfig(const YoloParams& params, int threadsPerWorker);
+    struct EnginePlan {
+        EngineConfig engine;
+        int threadsPerWorker = 1;
+        bool autotuned = false;
+    };
+    static EnginePlan planEngine(const YoloParams& params, int workers);
 
     // ONNX inference helpers
-    cv::Mat preprocessImage(const cv::Mat& image);
-    QVector<Cell> postprocessONNX(const cv::Mat& output, const cv::Mat& originalImage,
-                                   const QString& imagePath, const YoloParams& params);
+    cv::Mat preprocessImage(const cv::Mat& image, const cv::Size& inputSize, LetterboxInfo& letterbox);
+    cv::Mat preprocessBatch(const std::vector<cv::Mat>& images, const cv::Size& inputSize,
+                            std::vector<LetterboxInfo>& letterboxes);
+    static cv::Size resolveInputSize(const ModelRegistry::Lease& lease, const YoloParams& params);
+    // Outputs of one forward: detections [N, features, anchors] and,
+    // for segmentation models, mask prototypes [N, 32, 160, 160]
+    struct HeadOutput {
+        cv::Mat detections;
+        cv::Mat protos;
+    };
+    static HeadOutput runForward(DetectorEngine& engine, const cv::Mat& blob);
+    static cv::Mat batchSlice(const cv::Mat& output, int index);
+    static NmsOptions nmsOptions(const YoloParams& params);
+    static std::string yoloClassName(int classId);
+    using ForwardConsumer = std::function<void(size_t, const HeadOutput&, const LetterboxInfo&)>;
+    void forwardBatched(const std::vector<cv::Mat>& images, const cv::Size& inputSize,
+                        ModelRegistry::Lease& lease,
+                        const ForwardConsumer& consume);
+    CandidateSet collectCandidates(const HeadOutput& output, const LetterboxInfo& letterbox,
+                                   const YoloDecoder& decoder, const YoloParams& params, float scoreFloor);
+    // confThreshold filter, NMS (tile merge in tiled mode), minCellArea, masks, buildCells
+    QVector<Cell> cellsFromCandidates(const CandidateSet& candidates, const QString& imagePath,
+                                      const YoloParams& params);
+    static float candidateFloor(const YoloParams& params);
+
+    // Candidates above scoreThreshold, in image coordinates (before NMS)
+    struct Candidates {
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        std::vector<int> anchors;
+        std::vector<int> classIds;
+    };
+    Candidates decodeCandidates(const cv::Mat& output, const LetterboxInfo& letterbox,
+                                const YoloDecoder& decoder, float scoreThreshold);
+    // Result cache: parameters that change the detections of an image
+    static QByteArray cacheFingerprint(const YoloParams& params, const EngineConfig& engine,
+                                       const cv::Size& inputSize, bool candidates);
+    static std::vector<CachedDetection> toCachedDetections(const QVector<Cell>& detectedCells);
+    QVector<Cell> cellsFromCache(const std::vector<CachedDetection>& detections, const cv::Size& imageSize,
+                                 const QString& imagePath, const YoloParams& params);
+
+    QVector<Cell> buildCells(const std::vector<cv::Rect>& boxes, const std::vector<float>& confidences,
+                             const std::vector<int>& classIds,
+                             const std::vector<InstanceMask>& masks, const cv::Size& imageSize, const QString& imagePath, const YoloParams& params);
 
     // Image loading
     cv::Mat loadImageSafely(const QString& imagePath);
@@ -57,6 +239,13 @@ private:
     QString m_lastError;
     bool m_debugMode;
     mutable QMutex m_mutex;
+    ProgressCallback m_progressCallback;
+    ResultCallback m_resultCallback;
+    std::atomic<bool> m_cancelRequested{false};
+    QString m_modelHash;  // for result cache keys; empty = cache off for this run
+    EngineConfig m_engine;  // engine of the current run, part of the cache fingerprint
+    std::vector<std::shared_ptr<RetainedImage>> m_retained;  // input order
+    YoloParams m_retainedParams;
 };
 
 #endif // IMAGEPROCESSOR_H
@@ -0,0 +1,150 @@
+// letterbox.cpp - Fused letterbox preprocessing for the YOLO input tensor
+#include "letterbox.h"
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const float kInvScale = 1.0f / 255.0f;
+const float kPadValue = 114.0f / 255.0f;  // как в Ultralytics letterbox
+
+#if CV_SIMD128
+inline void storeScaled(const cv::v_uint8x16& v, float* dst, const cv::v_float32x4& scale) {
+    cv::v_uint16x8 lo, hi;
+    cv::v_expand(v, lo, hi);
+    cv::v_uint32x4 a, b, c, d;
+    cv::v_expand(lo, a, b);
+    cv::v_expand(hi, c, d);
+    cv::v_store(dst,      cv::v_cvt_f32(cv::v_reinterpret_as_s32(a)) * scale);
+    cv::v_store(dst + 4,  cv::v_cvt_f32(cv::v_reinterpret_as_s32(b)) * scale);
+    cv::v_store(dst + 8,  cv::v_cvt_f32(cv::v_reinterpret_as_s32(c)) * scale);
+    cv::v_store(dst + 12, cv::v_cvt_f32(cv::v_reinterpret_as_s32(d)) * scale);
+}
+#endif
+
+// Одна строка BGR (interleaved uchar) -> три плоскости float, каналы в порядке RGB
+void convertRow(const uchar* bgr, int count, float* r, float* g, float* b) {
+    int i = 0;
+#if CV_SIMD128
+    const cv::v_float32x4 vscale = cv::v_setall_f32(kInvScale);
+    for (; i <= count - 16; i += 16) {
+        cv::v_uint8x16 vb, vg, vr;
+        cv::v_load_deinterleave(bgr + 3 * i, vb, vg, vr);
+        storeScaled(vr, r + i, vscale);
+        storeScaled(vg, g + i, vscale);
+        storeScaled(vb, b + i, vscale);
+    }
+#endif
+    for (; i < count; ++i) {
+        b[i] = bgr[3 * i] * kInvScale;
+        g[i] = bgr[3 * i + 1] * kInvScale;
+        r[i] = bgr[3 * i + 2] * kInvScale;
+    }
+}
+
+inline void fillPad(float* r, float* g, float* b, int count) {
+    std::fill(r, r + count, kPadValue);
+    std::fill(g, g + count, kPadValue);
+    std::fill(b, b + count, kPadValue);
+}
+
+// Приводит вход к 3-канальному BGR (обычно уже BGR после imread/imdecode)
+cv::Mat ensureBgr(const cv::Mat& image) {
+    if (image.channels() == 3) {
+        return image;
+    }
+    cv::Mat bgr;
+    cv::cvtColor(image, bgr, image.channels() == 4 ? cv::COLOR_BGRA2BGR : cv::COLOR_GRAY2BGR);
+    return bgr;
+}
+
+} // namespace
+
+LetterboxInfo computeLetterbox(const cv::Size& sourceSize, const cv::Size& inputSize) {
+    LetterboxInfo info;
+    info.sourceSize = sourceSize;
+    info.inputSize = inputSize;
+    if (sourceSize.width <= 0 || sourceSize.height <= 0) {
+        return info;
+    }
+
+    info.scale = std::min(static_cast<float>(inputSize.width) / sourceSize.width,
+                          static_cast<float>(inputSize.height) / sourceSize.height);
+    info.scaledSize.width = std::max(1, std::min(inputSize.width,
+        static_cast<int>(std::lround(sourceSize.width * info.scale))));
+    info.scaledSize.height = std::max(1, std::min(inputSize.height,
+        static_cast<int>(std::lround(sourceSize.height * info.scale))));
+    info.padX = (inputSize.width - info.scaledSize.width) / 2;
+    info.padY = (inputSize.height - info.scaledSize.height) / 2;
+    return info;
+}
+
+LetterboxInfo letterboxToPlanar(const cv::Mat& image, const cv::Size& inputSize, float* dst) {
+    LetterboxInfo info = computeLetterbox(image.size(), inputSize);
+
+    // Масштабирование - единственный промежуточный буфер (uchar, переиспользуется потоком).
+    // Тайлы нужного размера и изображения в натуральную величину идут без него.
+    cv::Mat bgr = ensureBgr(image);
+    cv::Mat scaled;
+    if (bgr.size() == info.scaledSize) {
+        scaled = bgr;
+    } else {
+        static thread_local cv::Mat resizeBuffer;
+        cv::resize(bgr, resizeBuffer, info.scaledSize, 0, 0, cv::INTER_LINEAR);
+        scaled = resizeBuffer;
+    }
+
+    const int width = inputSize.width;
+    const int height = inputSize.height;
+    const size_t planeSize = static_cast<size_t>(width) * height;
+    float* planeR = dst;
+    float* planeG = dst + planeSize;
+    float* planeB = dst + 2 * planeSize;
+
+    const int left = info.padX;
+    const int right = width - info.padX - info.scaledSize.width;
+
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            const size_t offset = static_cast<size_t>(y) * width;
+            float* r = planeR + offset;
+            float* g = planeG + offset;
+            float* b = planeB + offset;
+
+            int srcY = y - info.padY;
+            if (srcY < 0 || srcY >= info.scaledSize.height) {
+                fillPad(r, g, b, width);
+                continue;
+            }
+
+            fillPad(r, g, b, left);
+            convertRow(scaled.ptr<uchar>(srcY), info.scaledSize.width, r + left, g + left, b + left);
+            fillPad(r + width - right, g + width - right, b + width - right, right);
+        }
+    });
+
+    return info;
+}
+
+cv::Mat letterboxBlob(const std::vector<cv::Mat>& images, const cv::Size& inputSize,
+                      std::vector<LetterboxInfo>& infos) {
+    const size_t imageFloats = 3 * static_cast<size_t>(inputSize.area());
+    const size_t totalFloats = imageFloats * images.size();
+
+    // Растет до максимального пакета и дальше не перевыделяется
+    static thread_local std::vector<float> buffer;
+    if (buffer.size() < totalFloats) {
+        buffer.resize(totalFloats);
+    }
+
+    infos.clear();
+    infos.reserve(images.size());
+    for (size_t k = 0; k < images.size(); ++k) {
+        infos.push_back(letterboxToPlanar(images[k], inputSize, buffer.data() + k * imageFloats));
+    }
+
+    int shape[] = {static_cast<int>(images.size()), 3, inputSize.height, inputSize.width};
+    return cv::Mat(4, shape, CV_32F, buffer.data());
+}
@@ -0,0 +1,35 @@
+// letterbox.h - Fused letterbox preprocessing for the YOLO input tensor
+#ifndef LETTERBOX_H
+#define LETTERBOX_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Геометрия letterbox: изображение масштабируется с сохранением пропорций
+// и центрируется на поле inputSize, остаток заливается серым (114).
+struct LetterboxInfo {
+    cv::Size sourceSize;   // исходное изображение
+    cv::Size inputSize;    // вход сети, например 640x640
+    cv::Size scaledSize;   // изображение внутри поля после масштабирования
+    float scale = 1.0f;    // input px / source px
+    int padX = 0;
+    int padY = 0;
+
+    // Координаты входа сети -> координаты исходного изображения
+    float toSourceX(float x) const { return (x - padX) / scale; }
+    float toSourceY(float y) const { return (y - padY) / scale; }
+    float toSourceLength(float length) const { return length / scale; }
+};
+
+LetterboxInfo computeLetterbox(const cv::Size& sourceSize, const cv::Size& inputSize);
+
+// Letterbox + BGR->RGB + 1/255 + HWC->CHW за один проход по пикселям.
+// dst - 3 * inputSize.area() float (плоскости R, G, B).
+LetterboxInfo letterboxToPlanar(const cv::Mat& image, const cv::Size& inputSize, float* dst);
+
+// Пакет изображений в тензор [N, 3, H, W]. Буфер переиспользуется между вызовами
+// и принадлежит потоку: результат действителен до следующего вызова в этом потоке.
+cv::Mat letterboxBlob(const std::vector<cv::Mat>& images, const cv::Size& inputSize,
+                      std::vector<LetterboxInfo>& infos);
+
+#endif // LETTERBOX_H
@@ -1,9 +1,19 @@
 #include <QApplication>
 #include <QtConcurrent/QtConcurrent>
+#include <QCoreApplication>
 #include "mainwindow.h"
+#include "batchrunner.h"
 #include "logger.h"
 
 int main(int argc, char* argv[]) {
+    // Пакетный режим: без QApplication, дисплей не нужен
+    if (BatchRunner::isBatchInvocation(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        INIT_LOGGER();
+        LOG_INFO("CellAnalyzer started in batch mode");
+        return BatchRunner().run(app.arguments());
+    }
+
     QApplication app(argc, argv);
     INIT_LOGGER();
     
@@ -14,6 +24,8 @@ int main(int argc, char* argv[]) {
     try {
         MainWindow window;
         window.show();
+        // Модель грузится в фоне, пока пользователь выбирает изображения
+        window.startModelWarmUp();
         return app.exec();
     } catch (const std::exception& e) {
         LOG_ERROR(QString("Fatal error: %1").arg(e.what()));
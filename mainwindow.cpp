@@ -15,7 +15,13 @@
 #include <QFile>
 #include <QTextStream>
 #include <QCoreApplication>
+#include <QStatusBar>
+#include <QtConcurrent/QtConcurrent>
+#include <QFileInfo>
+#include <QDir>
 #include "settingsmanager.h"
+#include "progressdialog.h"
+#include "folderwatcher.h"
 #include "logger.h"
 
 MainWindow::MainWindow(QWidget *parent)
@@ -27,9 +33,16 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Создаем меню
     setupMenuBar();
+    setupStatusBar();
 
     verificationWidget = nullptr;
     statisticsWidget = nullptr;
+    folderWatcher = nullptr;
+
+    analysisProcessor = nullptr;
+    analysisDialog = nullptr;
+    analysisWatcher = new QFutureWatcher<QString>(this);
+    connect(analysisWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::onAnalysisFinished);
 
     // Создаем главный виджет
     setCentralWidget(createMainWidget());
@@ -226,13 +239,15 @@ void MainWindow::startAnalysis() {
         QMessageBox::warning(this, "Предупреждение", "Пожалуйста, выберите изображения для анализа");
         return;
     }
+    if (analysisWatcher->isRunning()) {
+        return;
+    }
 
     LOG_INFO(QString("Starting YOLO analysis for %1 images").arg(selectedImagePaths.size()));
 
     // Создаем ImageProcessor
-    ImageProcessor* processor = nullptr;
     try {
-        processor = new ImageProcessor();
+        analysisProcessor = new ImageProcessor();
         LOG_INFO("ImageProcessor created successfully");
     } catch (const std::exception& e) {
         LOG_ERROR(QString("Failed to create ImageProcessor: %1").arg(e.what()));
@@ -240,56 +255,196 @@ void MainWindow::startAnalysis() {
         return;
     }
 
+    // Результаты и прогресс приходят из рабочих потоков - в GUI передаем через очередь событий
+    analysisProcessor->setResultCallback([this](const QString& imagePath, const QVector<Cell>& cells) {
+        QMetaObject::invokeMethod(this, [this, imagePath, cells]() {
+            onImageResults(imagePath, cells);
+        }, Qt::QueuedConnection);
+    });
+    analysisProcessor->setProgressCallback([this](int processed, int total, const QString& imagePath, int cellCount) {
+        QString fileName = QFileInfo(imagePath).fileName();
+        QMetaObject::invokeMethod(this, [this, processed, total, fileName, cellCount]() {
+            onAnalysisProgress(processed, total, fileName, cellCount);
+        }, Qt::QueuedConnection);
+    });
+
+    // Очищаем старый verification widget
+    if (verificationWidget) {
+        verificationWidget->deleteLater();
+        verificationWidget = nullptr;
+    }
+
+    analysisDialog = new ProgressDialog(this);
+    analysisDialog->setTitle("Анализ изображений");
+    connect(analysisDialog, &ProgressDialog::canceled, this, &MainWindow::cancelAnalysis);
+    analysisDialog->showDeterminate(QString("Обработка %1 изображений...").arg(selectedImagePaths.size()),
+                                    selectedImagePaths.size());
+    analyzeButton->setEnabled(false);
+
     // Обработка изображений с параметрами YOLO по умолчанию
     ImageProcessor::YoloParams params;  // Default: conf=0.25, iou=0.7, minArea=500
+    params.retainCandidates = true;     // ползунки порогов в VerificationWidget
+    params.spillCandidates = true;      // кандидаты в кэше результатов: повторный анализ без инференса
 
     LOG_INFO(QString("Processing %1 images with YOLO").arg(selectedImagePaths.size()));
 
-    try {
-        processor->processImages(selectedImagePaths, params);
-        LOG_INFO("Images processed successfully");
-    } catch (const std::exception& e) {
-        LOG_ERROR(QString("Failed to process images: %1").arg(e.what()));
-        QMessageBox::critical(this, "Ошибка", QString("Ошибка обработки изображений: %1").arg(e.what()));
-        delete processor;
+    // Анализ идет в фоне; если прогрев модели еще не закончен, поток дожидается
+    // его, чтобы не загружать вторую копию модели
+    QFuture<QString> warmUp = warmUpWatcher->future();
+    analysisParams = params;
+    ImageProcessor* processor = analysisProcessor;
+    QStringList paths = selectedImagePaths;
+    analysisWatcher->setFuture(QtConcurrent::run([warmUp, processor, paths, params]() mutable {
+        warmUp.waitForFinished();
+        try {
+            processor->processImages(paths, params);
+        } catch (const std::exception& e) {
+            return QString::fromUtf8(e.what());
+        }
+        return QString();
+    }));
+}
+
+void MainWindow::cancelAnalysis() {
+    if (!analysisProcessor) {
         return;
     }
+    LOG_INFO("Analysis cancel requested");
+    analysisProcessor->requestCancel();
+    if (analysisDialog) {
+        analysisDialog->setMessage("Отмена: завершается обработка начатых изображений...");
+    }
+}
 
-    LOG_INFO(QString("Detected %1 cells").arg(processor->getDetectedCells().size()));
+void MainWindow::onImageResults(const QString& imagePath, const QVector<Cell>& cells) {
+    // Изображения без клеток получают вкладку в onAnalysisFinished: до конца
+    // processImages неизвестно, сохранены ли для них кандидаты
+    if (cells.isEmpty()) {
+        return;
+    }
 
-    if (processor->getDetectedCells().isEmpty()) {
-        LOG_WARNING("No cells detected");
-        QMessageBox::information(this, "Результат", "Клетки не обнаружены на выбранных изображениях");
-        delete processor;
+    // Первое изображение с клетками: открываем проверку, не дожидаясь остальных.
+    // Дальше прогресс и отмена - в самом VerificationWidget.
+    if (!verificationWidget) {
+        if (!createVerificationWidget()) {
+            return;
+        }
+        if (analysisDialog) {
+            analysisDialog->close();
+            analysisDialog->deleteLater();
+            analysisDialog = nullptr;
+        }
+        if (analysisWatcher->isRunning()) {
+            connect(verificationWidget, &VerificationWidget::analysisCancelRequested, this, &MainWindow::cancelAnalysis);
+            verificationWidget->setAnalysisProgress(0, selectedImagePaths.size());
+        }
+        LOG_INFO("Setting VerificationWidget as central widget");
+        setCentralWidget(verificationWidget);
+    }
 
-        // Возвращаемся к главному экрану
-        LOG_INFO("Returning to main screen");
-        setCentralWidget(createMainWidget());
+    verificationWidget->addImageResults(imagePath, cells);
+}
+
+void MainWindow::onAnalysisProgress(int processed, int total, const QString& fileName, int cellCount) {
+    if (verificationWidget && analysisProcessor) {
+        verificationWidget->setAnalysisProgress(processed, total);
+        return;
+    }
+    if (!analysisDialog) {
         return;
     }
+    analysisDialog->setProgress(processed);
+    if (!analysisDialog->wasCanceled()) {
+        analysisDialog->setMessage(QString("Обработано %1 из %2 изображений").arg(processed).arg(total));
+    }
+    analysisDialog->addLogMessage(QString("%1: %2 клеток").arg(fileName).arg(cellCount));
+}
+
+void MainWindow::onAnalysisFinished() {
+    ImageProcessor* processor = analysisProcessor;
+    analysisProcessor = nullptr;
+
+    if (analysisDialog) {
+        analysisDialog->close();
+        analysisDialog->deleteLater();
+        analysisDialog = nullptr;
+    }
 
-    LOG_INFO("Creating copy of detected cells");
-    // Создаем копию вектора cells перед удалением processor
-    QVector<Cell> detectedCells = processor->getDetectedCells();
-    LOG_INFO(QString("Copied %1 cells").arg(detectedCells.size()));
+    QString error = analysisWatcher->result();
+    bool canceled = processor->wasCanceled();
+    LOG_INFO(QString("Detected %1 cells").arg(processor->getDetectedCells().size()));
 
-    delete processor;
-    LOG_INFO("ImageProcessor deleted");
+    // Изображения без клеток, но с кандидатами выше candidateFloor тоже получают
+    // вкладку: при более низком пороге клетки там могут найтись. Проверка
+    // открывается, даже если клеток нет ни на одном изображении; если же нет и
+    // кандидатов, ниже остается сообщение "Клетки не обнаружены".
+    if (processor->retainedCandidateCount() > 0) {
+        if (!verificationWidget && createVerificationWidget()) {
+            LOG_INFO("Setting VerificationWidget as central widget");
+            setCentralWidget(verificationWidget);
+        }
+        if (verificationWidget) {
+            for (const QString& path : selectedImagePaths) {
+                if (processor->retainedCandidateCount(path) > 0) {
+                    verificationWidget->addImageResults(path, QVector<Cell>());
+                }
+            }
+        }
+    }
 
-    // Очищаем старый verification widget
+    // Сохраненные кандидаты переходят к VerificationWidget для ползунков порогов
+    if (verificationWidget && processor->hasRetainedCandidates()) {
+        verificationWidget->setThresholdSource(processor, analysisParams);
+    } else {
+        delete processor;
+        LOG_INFO("ImageProcessor deleted");
+    }
+
+    // Результаты уже на экране: показываем ошибку, но оставляем их для проверки
     if (verificationWidget) {
-        verificationWidget->deleteLater();
-        verificationWidget = nullptr;
+        verificationWidget->finishAnalysis();
+        if (!error.isEmpty()) {
+            LOG_ERROR(QString("Failed to process images: %1").arg(error));
+            QMessageBox::critical(this, "Ошибка", QString("Ошибка обработки изображений: %1").arg(error));
+        } else if (canceled) {
+            LOG_INFO("Analysis canceled, keeping cells from finished images");
+        }
+        LOG_INFO("Analysis finished");
+        return;
     }
 
+    if (!error.isEmpty()) {
+        LOG_ERROR(QString("Failed to process images: %1").arg(error));
+        QMessageBox::critical(this, "Ошибка", QString("Ошибка обработки изображений: %1").arg(error));
+        analyzeButton->setEnabled(true);
+        return;
+    }
+    LOG_INFO("Images processed successfully");
+
+    if (canceled) {
+        // Отмена до первых результатов: остаемся на экране выбора
+        LOG_INFO("Analysis canceled before any cells were found");
+        analyzeButton->setEnabled(true);
+        return;
+    }
+
+    LOG_WARNING("No cells detected");
+    QMessageBox::information(this, "Результат", "Клетки не обнаружены на выбранных изображениях");
+
+    // Возвращаемся к главному экрану
+    LOG_INFO("Returning to main screen");
+    setCentralWidget(createMainWidget());
+}
+
+bool MainWindow::createVerificationWidget() {
     LOG_INFO("Creating VerificationWidget");
     try {
-        verificationWidget = new VerificationWidget(detectedCells);
+        verificationWidget = new VerificationWidget();
         LOG_INFO("VerificationWidget created successfully");
     } catch (const std::exception& e) {
         LOG_ERROR(QString("Failed to create VerificationWidget: %1").arg(e.what()));
         QMessageBox::critical(this, "Ошибка", QString("Не удалось создать окно верификации: %1").arg(e.what()));
-        return;
+        return false;
     }
 
     LOG_INFO("Connecting signals");
@@ -316,10 +471,7 @@ void MainWindow::startAnalysis() {
     });
 
     connect(verificationWidget, &VerificationWidget::statisticsRequested, this, &MainWindow::showStatistics);
-
-    LOG_INFO("Setting VerificationWidget as central widget");
-    setCentralWidget(verificationWidget);
-    LOG_INFO("Analysis started successfully");
+    return true;
 }
 
 void MainWindow::showVerification() {
@@ -344,6 +496,102 @@ void MainWindow::showVerification() {
 
 MainWindow::~MainWindow() {
     // Очистка ресурсов
+    if (folderWatcher) {
+        folderWatcher->stop();
+    }
+    if (analysisWatcher->isRunning()) {
+        analysisProcessor->requestCancel();
+        analysisWatcher->waitForFinished();
+    }
+    delete analysisProcessor;
+    warmUpWatcher->waitForFinished();
+}
+
+void MainWindow::setupStatusBar() {
+    watchStatusLabel = new QLabel(this);
+    watchStatusLabel->hide();
+    statusBar()->addPermanentWidget(watchStatusLabel);
+
+    modelStatusLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(modelStatusLabel);
+
+    warmUpWatcher = new QFutureWatcher<QString>(this);
+    connect(warmUpWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::onModelWarmUpFinished);
+}
+
+void MainWindow::toggleFolderWatch() {
+    if (folderWatcher) {
+        folderWatcher->stop();
+        folderWatcher->deleteLater();
+        folderWatcher = nullptr;
+        watchAction->setText("Следить за папкой...");
+        return;
+    }
+
+    QString directory = QFileDialog::getExistingDirectory(this, "Папка для наблюдения");
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    // Результаты копятся в results/ рядом с выгрузкой кнопки "Сохранить"
+    QString resultsDir = QDir::currentPath() + "/results";
+    QDir().mkpath(resultsDir);
+
+    FolderWatcher::Options options;
+    options.directory = directory;
+    options.outputPath = resultsDir + QString("/watch_%1.csv").arg(QFileInfo(directory).fileName());
+    options.coefficient = SettingsManager::instance().getCoefficient();
+
+    folderWatcher = new FolderWatcher(options, this);
+    connect(folderWatcher, &FolderWatcher::statusChanged, watchStatusLabel, &QLabel::setText);
+    connect(folderWatcher, &FolderWatcher::errorOccurred, this, [this](const QString& message) {
+        QMessageBox::warning(this, "Наблюдение за папкой", message);
+    });
+
+    try {
+        folderWatcher->start();
+    } catch (const std::exception& e) {
+        QMessageBox::critical(this, "Ошибка", QString("Не удалось начать наблюдение: %1").arg(e.what()));
+        delete folderWatcher;
+        folderWatcher = nullptr;
+        return;
+    }
+
+    watchStatusLabel->show();
+    watchAction->setText("Остановить наблюдение за папкой");
+    LOG_INFO(QString("Folder watch started: %1 -> %2").arg(directory, options.outputPath));
+}
+
+void MainWindow::setModelStatus(const QString& text, const QString& color) {
+    modelStatusLabel->setText(QString("<span style=\"color:%1\">&#9679;</span> %2").arg(color, text));
+}
+
+void MainWindow::startModelWarmUp() {
+    if (warmUpWatcher->isRunning()) {
+        return;
+    }
+
+    setModelStatus("Модель: загрузка...", "#FFA000");
+    LOG_INFO("Starting background model warm-up");
+
+    // Параметры те же, что использует startAnalysis
+    warmUpWatcher->setFuture(QtConcurrent::run([]() {
+        QString error;
+        ImageProcessor::warmUp(ImageProcessor::YoloParams(), &error);
+        return error;
+    }));
+}
+
+void MainWindow::onModelWarmUpFinished() {
+    QString error = warmUpWatcher->result();
+    if (error.isEmpty()) {
+        setModelStatus("Модель готова", "#4CAF50");
+        modelStatusLabel->setToolTip(QString());
+    } else {
+        // Анализ все равно попробует загрузить модель и покажет ошибку
+        setModelStatus("Модель не загружена", "#f44336");
+        modelStatusLabel->setToolTip(error);
+    }
 }
 
 void MainWindow::resizeEvent(QResizeEvent* event) {
@@ -372,6 +620,14 @@ void MainWindow::resizeEvent(QResizeEvent* event) {
 void MainWindow::setupMenuBar() {
     QMenuBar* menuBar = this->menuBar();
 
+    // Меню "Файл"
+    QMenu* fileMenu = menuBar->addMenu("Файл");
+
+    // Наблюдение за папкой: новые снимки обрабатываются в фоне
+    watchAction = new QAction("Следить за папкой...", this);
+    connect(watchAction, &QAction::triggered, this, &MainWindow::toggleFolderWatch);
+    fileMenu->addAction(watchAction);
+
     // Меню "Справка"
     QMenu* helpMenu = menuBar->addMenu("Справка");
 
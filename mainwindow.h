@@ -10,10 +10,17 @@
 #include <QPushButton>
 #include <QSlider>
 #include <QLabel>
+#include <QFutureWatcher>
+#include <QAction>
 #include "previewgrid.h"
 #include "verificationwidget.h"
+#include "imageprocessor.h"
 #include "statisticswidget.h"
 
+class ImageProcessor;
+class ProgressDialog;
+class FolderWatcher;
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
@@ -21,6 +28,10 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Загружает и прогревает модель по умолчанию в фоне; вызывается из main()
+    // после show(). Состояние показывается в строке состояния.
+    void startModelWarmUp();
+
 private slots:
     void selectImages();
     void startAnalysis();
@@ -29,6 +40,10 @@ private slots:
     void updateAnalysisButtonState();
     void clearImages();
     void onBackFromStatistics();
+    void onModelWarmUpFinished();
+    void onAnalysisFinished();
+    void cancelAnalysis();
+    void toggleFolderWatch();
 
 private:
     PreviewGrid* previewGrid;
@@ -47,11 +62,30 @@ private:
     QPushButton* addImagesButton;
     QWidget* toolbarWidget;
 
+    QLabel* modelStatusLabel;
+    QFutureWatcher<QString>* warmUpWatcher;  // результат: пустая строка или текст ошибки
+
+    // Текущий фоновый анализ
+    ImageProcessor* analysisProcessor;
+    ImageProcessor::YoloParams analysisParams;
+    ProgressDialog* analysisDialog;
+    QFutureWatcher<QString>* analysisWatcher;  // результат: пустая строка или текст ошибки
+
+    // Наблюдение за папкой (меню "Файл")
+    FolderWatcher* folderWatcher;
+    QLabel* watchStatusLabel;
+    QAction* watchAction;
+
 private:
     QWidget* createMainWidget();
     void setupInitialState();
     void setupWithImagesState();
     void setupMenuBar();
+    void setupStatusBar();
+    void setModelStatus(const QString& text, const QString& color);
+    void onAnalysisProgress(int processed, int total, const QString& fileName, int cellCount);
+    void onImageResults(const QString& imagePath, const QVector<Cell>& cells);
+    bool createVerificationWidget();
 
 protected:
     void resizeEvent(QResizeEvent* event) override;
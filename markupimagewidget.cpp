@@ -22,7 +22,7 @@ InteractiveImageLabel::InteractiveImageLabel(QWidget* parent)
     setCursor(Qt::CrossCursor);
 }
 
-void InteractiveImageLabel::setCells(const QVector<Cell>& cells)
+void InteractiveImageLabel::setCells(const CellTable& cells)
 {
     m_cells = cells;
     updateDisplay();
@@ -48,12 +48,17 @@ void InteractiveImageLabel::updateDisplay()
 
     // Calculate maximum circle extension beyond image boundaries
     int maxExtension = 0;
-    for (const Cell& cell : m_cells) {
+    const int width = m_originalPixmap.width();
+    const int height = m_originalPixmap.height();
+    const int* centerX = m_cells.centerX.data();
+    const int* centerY = m_cells.centerY.data();
+    const int* radius = m_cells.radius.data();
+    for (int i = 0; i < m_cells.size(); ++i) {
         // Check how far circles extend beyond image boundaries
-        int leftExt = qMax(0, static_cast<int>(cell.radius - cell.center_x));
-        int rightExt = qMax(0, static_cast<int>((cell.center_x + cell.radius) - m_originalPixmap.width()));
-        int topExt = qMax(0, static_cast<int>(cell.radius - cell.center_y));
-        int bottomExt = qMax(0, static_cast<int>((cell.center_y + cell.radius) - m_originalPixmap.height()));
+        int leftExt = qMax(0, radius[i] - centerX[i]);
+        int rightExt = qMax(0, (centerX[i] + radius[i]) - width);
+        int topExt = qMax(0, radius[i] - centerY[i]);
+        int bottomExt = qMax(0, (centerY[i] + radius[i]) - height);
 
         maxExtension = qMax(maxExtension, qMax(qMax(leftExt, rightExt), qMax(topExt, bottomExt)));
     }
@@ -78,8 +83,6 @@ void InteractiveImageLabel::updateDisplay()
 
     // Draw all cells with offset coordinates
     for (int i = 0; i < m_cells.size(); ++i) {
-        const Cell& cell = m_cells[i];
-
         // Determine color based on selection
         bool isSelected = (i == m_selectedCellIndex);
 
@@ -94,14 +97,14 @@ void InteractiveImageLabel::updateDisplay()
         }
 
         // Draw circle with offset (now can extend beyond original image boundaries)
-        QPointF center(cell.center_x + maxExtension, cell.center_y + maxExtension);
-        painter.drawEllipse(center, cell.radius, cell.radius);
+        QPointF center(centerX[i] + maxExtension, centerY[i] + maxExtension);
+        painter.drawEllipse(center, radius[i], radius[i]);
 
         // Draw cell number for selected cell
         if (isSelected) {
             painter.setPen(QPen(QColor(255, 255, 0), 1));
             painter.setFont(QFont("Arial", 12, QFont::Bold));
-            painter.drawText(center.x() - 20, center.y() - cell.radius - 10,
+            painter.drawText(center.x() - 20, center.y() - radius[i] - 10,
                            QString::number(i + 1));
         }
     }
@@ -137,15 +140,13 @@ int InteractiveImageLabel::findCellAtPosition(const QPoint& pos)
     // Find the cell closest to the click position
     // Account for canvas offset (extended canvas for border circles)
     for (int i = 0; i < m_cells.size(); ++i) {
-        const Cell& cell = m_cells[i];
-
         // Calculate distance from click to cell center (with canvas offset)
-        double dx = pos.x() - (cell.center_x + m_canvasOffset);
-        double dy = pos.y() - (cell.center_y + m_canvasOffset);
+        double dx = pos.x() - (m_cells.centerX[i] + m_canvasOffset);
+        double dy = pos.y() - (m_cells.centerY[i] + m_canvasOffset);
         double distance = std::sqrt(dx * dx + dy * dy);
 
         // Check if click is within cell radius
-        if (distance <= cell.radius) {
+        if (distance <= m_cells.radius[i]) {
             return i;
         }
     }
@@ -209,6 +210,11 @@ void MarkupImageWidget::setImage(const QString& imagePath)
 }
 
 void MarkupImageWidget::setCells(const QVector<Cell>& cells)
+{
+    setCells(CellTable(cells));
+}
+
+void MarkupImageWidget::setCells(const CellTable& cells)
 {
     m_cells = cells;
     m_imageLabel->setCells(cells);
@@ -292,14 +298,8 @@ void MarkupImageWidget::updateZoom()
     m_imageLabel->setOriginalImage(scaledPixmap);
 
     // Обновляем ячейки с учётом масштаба
-    QVector<Cell> scaledCells;
-    for (const Cell& cell : m_cells) {
-        Cell scaledCell = cell;
-        scaledCell.center_x *= m_zoomFactor;
-        scaledCell.center_y *= m_zoomFactor;
-        scaledCell.radius *= m_zoomFactor;
-        scaledCells.append(scaledCell);
-    }
+    CellTable scaledCells = m_cells;
+    scaledCells.scaleGeometry(m_zoomFactor);
 
     m_imageLabel->setCells(scaledCells);
     LOG_DEBUG(QString("Zoom updated to %1%").arg(m_zoomFactor * 100, 0, 'f', 0));
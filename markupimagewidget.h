@@ -10,6 +10,7 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include "cell.h"
+#include "celltable.h"
 
 // Interactive label that handles mouse clicks and drawing
 class InteractiveImageLabel : public QLabel {
@@ -17,7 +18,7 @@ class InteractiveImageLabel : public QLabel {
 
 public:
     explicit InteractiveImageLabel(QWidget* parent = nullptr);
-    void setCells(const QVector<Cell>& cells);
+    void setCells(const CellTable& cells);
     void setSelectedCell(int index);
     void setOriginalImage(const QPixmap& pixmap);
     void updateDisplay();
@@ -34,7 +35,7 @@ private:
     int findCellAtPosition(const QPoint& pos);
 
 private:
-    QVector<Cell> m_cells;
+    CellTable m_cells;  // only geometry columns are used
     int m_selectedCellIndex;
     QPixmap m_originalPixmap;
     int m_canvasOffset = 0;  // Offset for extended canvas
@@ -50,6 +51,7 @@ public:
     void setImage(const QPixmap& pixmap);
     void setImage(const QString& imagePath);
     void setCells(const QVector<Cell>& cells);
+    void setCells(const CellTable& cells);
     void setSelectedCell(int index);
     void clear();
 
@@ -75,7 +77,7 @@ private:
     InteractiveImageLabel* m_imageLabel;
     QScrollArea* m_scrollArea;
     QPixmap m_currentPixmap;
-    QVector<Cell> m_cells;
+    CellTable m_cells;
     int m_selectedCellIndex;
     double m_zoomFactor;
 };
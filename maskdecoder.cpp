@@ -0,0 +1,89 @@
+// maskdecoder.cpp - Instance masks for the YOLOv8-seg head
+#include "maskdecoder.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+std::vector<InstanceMask> decodeInstanceMasks(const cv::Mat& protos, const cv::Mat& coefficients,
+                                              const std::vector<cv::Rect>& boxes,
+                                              const LetterboxInfo& letterbox) {
+    std::vector<InstanceMask> masks(boxes.size());
+    if (boxes.empty() || protos.dims != 4 || protos.type() != CV_32F || !protos.isContinuous()) {
+        return masks;
+    }
+
+    const int numProtos = protos.size[1];
+    const int protoHeight = protos.size[2];
+    const int protoWidth = protos.size[3];
+    if (coefficients.type() != CV_32F || coefficients.cols != numProtos ||
+        coefficients.rows != static_cast<int>(boxes.size())) {
+        return masks;
+    }
+
+    const float* protoData = protos.ptr<float>(0);
+    const size_t planeSize = static_cast<size_t>(protoWidth) * protoHeight;
+
+    // Пиксели прототипов на пиксель входа сети (160 / 640 для YOLOv8-seg)
+    const double protoScaleX = static_cast<double>(protoWidth) / letterbox.inputSize.width;
+    const double protoScaleY = static_cast<double>(protoHeight) / letterbox.inputSize.height;
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(boxes.size())), [&](const cv::Range& range) {
+        cv::Mat roiProtos;
+        cv::Mat logits;
+        cv::Mat upsampled;
+
+        for (int k = range.start; k < range.end; ++k) {
+            const cv::Rect& box = boxes[k];
+            if (box.width <= 0 || box.height <= 0) {
+                continue;
+            }
+
+            // Рамка в координатах прототипов: исходник -> вход сети (letterbox) -> прототипы
+            double fx0 = (box.x * letterbox.scale + letterbox.padX) * protoScaleX;
+            double fy0 = (box.y * letterbox.scale + letterbox.padY) * protoScaleY;
+            double fx1 = ((box.x + box.width) * letterbox.scale + letterbox.padX) * protoScaleX;
+            double fy1 = ((box.y + box.height) * letterbox.scale + letterbox.padY) * protoScaleY;
+
+            int px0 = std::max(0, std::min(protoWidth - 1, static_cast<int>(std::floor(fx0))));
+            int py0 = std::max(0, std::min(protoHeight - 1, static_cast<int>(std::floor(fy0))));
+            int px1 = std::max(px0 + 1, std::min(protoWidth, static_cast<int>(std::ceil(fx1))));
+            int py1 = std::max(py0 + 1, std::min(protoHeight, static_cast<int>(std::ceil(fy1))));
+            int roiWidth = px1 - px0;
+            int roiHeight = py1 - py0;
+
+            // Прототипы внутри рамки: [numProtos x roiWidth*roiHeight]
+            roiProtos.create(numProtos, roiWidth * roiHeight, CV_32F);
+            for (int p = 0; p < numProtos; ++p) {
+                float* dst = roiProtos.ptr<float>(p);
+                const float* plane = protoData + p * planeSize;
+                for (int y = py0; y < py1; ++y) {
+                    std::memcpy(dst + (y - py0) * roiWidth, plane + static_cast<size_t>(y) * protoWidth + px0,
+                                roiWidth * sizeof(float));
+                }
+            }
+
+            // [1 x 32] x [32 x roi] -> логиты маски внутри рамки
+            cv::gemm(coefficients.row(k), roiProtos, 1.0, cv::noArray(), 0.0, logits);
+            cv::Mat logitsRoi = logits.reshape(1, roiHeight);
+
+            // Центр пикселя рамки (u, v) -> координата в логитах ROI
+            double ax = letterbox.scale * protoScaleX;
+            double ay = letterbox.scale * protoScaleY;
+            double bx = ((box.x + 0.5) * letterbox.scale + letterbox.padX) * protoScaleX - 0.5 - px0;
+            double by = ((box.y + 0.5) * letterbox.scale + letterbox.padY) * protoScaleY - 0.5 - py0;
+            cv::Matx23d toRoi(ax, 0.0, bx,
+                              0.0, ay, by);
+            cv::warpAffine(logitsRoi, upsampled, toRoi, box.size(),
+                           cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+
+            // sigmoid(x) > 0.5  <=>  x > 0
+            InstanceMask& mask = masks[k];
+            cv::compare(upsampled, 0.0, mask.mask, cv::CMP_GT);
+            mask.area = cv::countNonZero(mask.mask);
+            mask.equivalentDiameter = 2.0 * std::sqrt(mask.area / CV_PI);
+        }
+    });
+
+    return masks;
+}
@@ -0,0 +1,27 @@
+// maskdecoder.h - Instance masks for the YOLOv8-seg head
+#ifndef MASKDECODER_H
+#define MASKDECODER_H
+
+#include "letterbox.h"
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Маска одной детекции в пикселях исходного изображения
+struct InstanceMask {
+    cv::Mat mask;                   // CV_8U 0/255 размера box
+    int area = 0;                   // число пикселей маски
+    double equivalentDiameter = 0;  // диаметр круга той же площади
+
+    bool isEmpty() const { return area <= 0; }
+};
+
+// Маски только для выживших после NMS детекций.
+// protos - прототипы [1, 32, mh, mw], coefficients - [K x 32] (по строке на детекцию),
+// boxes - рамки детекций в координатах исходного изображения.
+// Логиты считаются только внутри рамки (в разрешении прототипов) и затем
+// интерполируются в пиксели рамки; полноразмерные маски не строятся.
+std::vector<InstanceMask> decodeInstanceMasks(const cv::Mat& protos, const cv::Mat& coefficients,
+                                              const std::vector<cv::Rect>& boxes,
+                                              const LetterboxInfo& letterbox);
+
+#endif // MASKDECODER_H
@@ -0,0 +1,253 @@
+// modelregistry.cpp - Process-wide cache of loaded detector engines
+#include "modelregistry.h"
+#include "logger.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <stdexcept>
+
+ModelRegistry& ModelRegistry::instance() {
+    static ModelRegistry instance;
+    return instance;
+}
+
+QString ModelRegistry::resolveModelPath(const QString& modelPath) {
+    QString appDir = QCoreApplication::applicationDirPath();
+
+    QStringList modelSearchPaths = {
+        QDir(appDir).filePath(modelPath),
+        QDir(appDir).filePath("../" + modelPath),
+        QDir(appDir).filePath("../../" + modelPath),
+        modelPath,
+        QString("cell-analyzer/%1").arg(modelPath)
+    };
+
+    for (const QString& path : modelSearchPaths) {
+        if (QFile::exists(path)) {
+            return QFileInfo(path).absoluteFilePath();
+        }
+    }
+
+    LOG_ERROR(QString("ONNX model not found. Searched in:"));
+    for (const QString& path : modelSearchPaths) {
+        LOG_ERROR(QString("  - %1").arg(path));
+    }
+    return QString();
+}
+
+QString ModelRegistry::makeKey(const QString& resolvedPath, const EngineConfig& config) {
+    return QString("%1|%2").arg(resolvedPath, config.key());
+}
+
+ModelRegistry::Lease ModelRegistry::acquire(const QString& modelPath, const EngineConfig& config) {
+    QString resolvedPath = resolveModelPath(modelPath);
+    if (resolvedPath.isEmpty()) {
+        throw std::runtime_error("ONNX model not found");
+    }
+
+    QFileInfo info(resolvedPath);
+    QString key = makeKey(resolvedPath, config);
+
+    Lease lease;
+    lease.m_key = key;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        auto it = m_entries.find(key);
+        if (it != m_entries.end() &&
+            (it->lastModified != info.lastModified() || it->fileSize != info.size())) {
+            LOG_INFO(QString("ONNX model changed on disk, reloading: %1").arg(resolvedPath));
+            m_entries.erase(it);
+            it = m_entries.end();
+        }
+
+        if (it == m_entries.end()) {
+            Entry entry;
+            entry.resolvedPath = resolvedPath;
+            entry.lastModified = info.lastModified();
+            entry.fileSize = info.size();
+            entry.generation = m_nextGeneration++;
+            it = m_entries.insert(key, entry);
+        }
+
+        lease.m_generation = it->generation;
+        if (!it->idleEngines.isEmpty()) {
+            lease.m_engine = it->idleEngines.takeLast();
+            lease.m_inputSize = it->inputSize;
+            lease.m_decoder = it->decoder;
+            lease.m_valid = true;
+            return lease;
+        }
+    }
+
+    // Загрузка идет без блокировки, чтобы рабочие потоки грузили свои копии параллельно
+    cv::Size inputSize;
+    lease.m_engine = loadEngine(resolvedPath, config, inputSize);
+    lease.m_inputSize = inputSize;
+    lease.m_valid = true;
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->generation == lease.m_generation && !it->inputSizeKnown) {
+        it->inputSize = inputSize;
+        it->inputSizeKnown = true;
+    }
+    return lease;
+}
+
+void ModelRegistry::giveBack(const QString& key, quint64 generation,
+                             const std::shared_ptr<DetectorEngine>& engine) {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->generation == generation) {
+        it->idleEngines.append(engine);
+    }
+}
+
+std::shared_ptr<DetectorEngine> ModelRegistry::loadEngine(const QString& resolvedPath, const EngineConfig& config,
+                                                          cv::Size& inputSize) {
+    LOG_INFO(QString("Loading ONNX model: %1 (%2)").arg(resolvedPath, config.describe()));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::shared_ptr<DetectorEngine> engine = DetectorEngine::create(config);
+    engine->load(resolvedPath);
+
+    EngineIO io = engine->describe();
+    inputSize = io.inputSize;
+    if (inputSize.empty()) {
+        LOG_INFO("ONNX model input has dynamic spatial axes, size is taken from YoloParams");
+    } else {
+        LOG_INFO(QString("ONNX model input: %1x%2").arg(inputSize.width).arg(inputSize.height));
+    }
+    LOG_DEBUG(QString("ONNX model outputs: %1").arg(io.outputNames.join(", ")));
+
+    // Первый прогон выполняет fusion слоев и выделение буферов - делаем его здесь,
+    // чтобы первое реальное изображение не платило за это
+    qint64 loadMs = timer.restart();
+    engine->warmUp(inputSize.empty() ? cv::Size(640, 640) : inputSize);
+    LOG_INFO(QString("%1 ready: load %2 ms, warm-up %3 ms")
+        .arg(engine->name()).arg(loadMs).arg(timer.elapsed()));
+
+    return engine;
+}
+
+void ModelRegistry::invalidate(const QString& modelPath) {
+    QString resolvedPath = QFileInfo(modelPath).isAbsolute()
+        ? modelPath : resolveModelPath(modelPath);
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->resolvedPath == resolvedPath) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    LOG_INFO(QString("ONNX model cache invalidated: %1").arg(resolvedPath));
+}
+
+void ModelRegistry::clear() {
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    LOG_INFO("ONNX model cache cleared");
+}
+
+bool ModelRegistry::contains(const QString& modelPath, const EngineConfig& config) const {
+    QString resolvedPath = resolveModelPath(modelPath);
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.constFind(makeKey(resolvedPath, config));
+    return it != m_entries.constEnd() && !it->idleEngines.isEmpty();
+}
+
+// ============================================================================
+// Lease
+// ============================================================================
+
+ModelRegistry::BatchMode ModelRegistry::Lease::batchMode() const {
+    ModelRegistry& registry = ModelRegistry::instance();
+    QMutexLocker locker(&registry.m_mutex);
+    auto it = registry.m_entries.constFind(m_key);
+    if (it == registry.m_entries.constEnd() || it->generation != m_generation) {
+        return BatchMode::Unknown;
+    }
+    return it->batchMode;
+}
+
+void ModelRegistry::Lease::setBatchMode(BatchMode mode) {
+    ModelRegistry& registry = ModelRegistry::instance();
+    QMutexLocker locker(&registry.m_mutex);
+    auto it = registry.m_entries.find(m_key);
+    if (it != registry.m_entries.end() && it->generation == m_generation) {
+        it->batchMode = mode;
+    }
+}
+
+const YoloDecoder& ModelRegistry::Lease::decoder(const cv::Mat& output, const cv::Size& inputSize) {
+    if (m_decoder.matches(output)) {
+        return m_decoder;
+    }
+
+    ModelRegistry& registry = ModelRegistry::instance();
+    QMutexLocker locker(&registry.m_mutex);
+    auto it = registry.m_entries.find(m_key);
+    bool current = it != registry.m_entries.end() && it->generation == m_generation;
+    if (current && it->decoder.matches(output)) {
+        m_decoder = it->decoder;
+        return m_decoder;
+    }
+
+    // Новая модель или (для динамических осей) другой размер входа
+    m_decoder = selectYoloDecoder(detectYoloHead(output, yoloAnchorCount(inputSize)));
+    if (m_decoder.isValid()) {
+        LOG_INFO(QString("ONNX output head: %1 features x %2 anchors, decoder %3")
+            .arg(m_decoder.head.numFeatures).arg(m_decoder.head.numAnchors).arg(m_decoder.name));
+        if (current) {
+            it->decoder = m_decoder;
+        }
+    }
+    return m_decoder;
+}
+
+ModelRegistry::Lease::Lease(Lease&& other) noexcept
+    : m_key(std::move(other.m_key))
+    , m_generation(other.m_generation)
+    , m_engine(std::move(other.m_engine))
+    , m_decoder(other.m_decoder)
+    , m_inputSize(other.m_inputSize)
+    , m_valid(other.m_valid)
+{
+    other.m_valid = false;
+}
+
+ModelRegistry::Lease& ModelRegistry::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_key = std::move(other.m_key);
+        m_generation = other.m_generation;
+        m_engine = std::move(other.m_engine);
+        m_decoder = other.m_decoder;
+        m_inputSize = other.m_inputSize;
+        m_valid = other.m_valid;
+        other.m_valid = false;
+    }
+    return *this;
+}
+
+ModelRegistry::Lease::~Lease() {
+    release();
+}
+
+void ModelRegistry::Lease::release() {
+    if (m_valid) {
+        ModelRegistry::instance().giveBack(m_key, m_generation, m_engine);
+        m_engine.reset();
+        m_decoder = YoloDecoder();
+        m_valid = false;
+    }
+}
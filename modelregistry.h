@@ -0,0 +1,112 @@
+// modelregistry.h - Process-wide cache of loaded detector engines
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <QString>
+#include <QMap>
+#include <QList>
+#include <QMutex>
+#include <QDateTime>
+#include <memory>
+#include "detectorengine.h"
+#include "yolodecoder.h"
+
+// Хранит загруженные и прогретые движки инференса по ключу (модель, EngineConfig).
+// Живет между вызовами ImageProcessor::processImages и между анализами,
+// запущенными из MainWindow. Запись сбрасывается, если файл модели изменился.
+//
+// Движок нельзя использовать из нескольких потоков одновременно, поэтому
+// он выдается в аренду (Lease): каждый рабочий поток владеет своим экземпляром,
+// а после завершения пакета экземпляр возвращается в пул для следующих анализов.
+class ModelRegistry {
+public:
+    // Поддерживает ли модель пакет из N изображений за один forward.
+    // Определяется при первой попытке пакетного инференса.
+    enum class BatchMode {
+        Unknown,
+        Dynamic,  // экспорт с динамической batch-осью
+        Fixed     // batch = 1, пакеты разбиваются на одиночные forward
+    };
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        DetectorEngine& engine() { return *m_engine; }
+        bool isValid() const { return m_valid; }
+
+        BatchMode batchMode() const;
+        void setBatchMode(BatchMode mode);
+
+        // Размер входа, объявленный в модели; пустой для экспорта с динамическими осями
+        cv::Size modelInputSize() const { return m_inputSize; }
+
+        // Декодер выхода выбирается один раз на загруженную модель по форме
+        // первого выхода и дальше берется из кэша. inputSize - размер входа,
+        // с которым получен output (определяет число якорей).
+        const YoloDecoder& decoder(const cv::Mat& output, const cv::Size& inputSize);
+
+    private:
+        friend class ModelRegistry;
+        void release();
+
+        QString m_key;
+        quint64 m_generation = 0;
+        std::shared_ptr<DetectorEngine> m_engine;
+        YoloDecoder m_decoder;
+        cv::Size m_inputSize;
+        bool m_valid = false;
+    };
+
+    static ModelRegistry& instance();
+
+    // Ищет модель в стандартных путях относительно exe. Возвращает абсолютный
+    // путь или пустую строку, если модель не найдена.
+    static QString resolveModelPath(const QString& modelPath);
+
+    // Выдает движок из пула или загружает новый (с прогревом).
+    // Бросает std::runtime_error, если модель не найдена или не читается.
+    Lease acquire(const QString& modelPath, const EngineConfig& config);
+
+    // Явный сброс кэша; выданные ранее движки после возврата не попадут в пул
+    void invalidate(const QString& modelPath);
+    void clear();
+
+    bool contains(const QString& modelPath, const EngineConfig& config) const;
+
+private:
+    ModelRegistry() = default;
+    ~ModelRegistry() = default;
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    struct Entry {
+        QString resolvedPath;
+        QDateTime lastModified;
+        qint64 fileSize = 0;
+        quint64 generation = 0;
+        QList<std::shared_ptr<DetectorEngine>> idleEngines;  // прогретые движки, не занятые потоками
+        BatchMode batchMode = BatchMode::Unknown;
+        YoloDecoder decoder;
+        cv::Size inputSize;  // из графа модели, пустой если оси динамические
+        bool inputSizeKnown = false;
+    };
+
+    static QString makeKey(const QString& resolvedPath, const EngineConfig& config);
+    static std::shared_ptr<DetectorEngine> loadEngine(const QString& resolvedPath, const EngineConfig& config,
+                                                      cv::Size& inputSize);
+
+    void giveBack(const QString& key, quint64 generation, const std::shared_ptr<DetectorEngine>& engine);
+
+    QMap<QString, Entry> m_entries;  // key -> loaded engines
+    quint64 m_nextGeneration = 1;
+    mutable QMutex m_mutex;
+};
+
+#endif // MODELREGISTRY_H
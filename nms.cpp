@@ -0,0 +1,119 @@
+// nms.cpp - Class-aware non-maximum suppression for dense slides
+#include "nms.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+const long long kMaxGridCells = 1 << 20;
+
+inline float rectIoU(const cv::Rect& a, const cv::Rect& b) {
+    int inter = (a & b).area();
+    if (inter <= 0) return 0.0f;
+    int uni = a.area() + b.area() - inter;
+    return uni > 0 ? static_cast<float>(inter) / uni : 0.0f;
+}
+
+} // namespace
+
+std::vector<int> nonMaxSuppression(const std::vector<cv::Rect>& boxes, const std::vector<float>& scores,
+                                   const std::vector<int>& classIds, const NmsOptions& options) {
+    std::vector<int> keep;
+    const int count = static_cast<int>(std::min(boxes.size(), scores.size()));
+    if (count == 0) {
+        return keep;
+    }
+
+    // 1. Порядок по убыванию score, при topK - только K лучших
+    std::vector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    auto byScore = [&scores](int a, int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    };
+    if (options.topK > 0 && options.topK < count) {
+        std::partial_sort(order.begin(), order.begin() + options.topK, order.end(), byScore);
+        order.resize(options.topK);
+    } else {
+        std::sort(order.begin(), order.end(), byScore);
+    }
+
+    // 2. Смещение по классам: каждый класс в своей полосе по X
+    const bool shiftByClass = options.classAware && classIds.size() == boxes.size();
+    int minX = boxes[order[0]].x, minY = boxes[order[0]].y;
+    int maxX = minX, maxY = minY;
+    std::vector<int> sizes;
+    sizes.reserve(order.size());
+    for (int i : order) {
+        const cv::Rect& r = boxes[i];
+        minX = std::min(minX, r.x);
+        minY = std::min(minY, r.y);
+        maxX = std::max(maxX, r.x + r.width);
+        maxY = std::max(maxY, r.y + r.height);
+        sizes.push_back(std::max(r.width, r.height));
+    }
+    const int classStride = maxX - minX + 1;
+
+    std::vector<cv::Rect> shifted(count);
+    int maxClass = 0;
+    for (int i : order) {
+        int cls = shiftByClass ? std::max(0, classIds[i]) : 0;
+        maxClass = std::max(maxClass, cls);
+        shifted[i] = boxes[i] - cv::Point(minX, minY) + cv::Point(cls * classStride, 0);
+    }
+
+    // 3. Равномерная сетка с ячейкой ~ двух медианных рамок
+    std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2, sizes.end());
+    const long long extentX = static_cast<long long>(classStride) * (maxClass + 1);
+    const long long extentY = maxY - minY + 1;
+    int cellSize = std::max(1, 2 * sizes[sizes.size() / 2]);
+    while ((extentX / cellSize + 1) * (extentY / cellSize + 1) > kMaxGridCells) {
+        cellSize *= 2;
+    }
+    const int gridWidth = static_cast<int>(extentX / cellSize) + 1;
+    const int gridHeight = static_cast<int>(extentY / cellSize) + 1;
+
+    std::vector<std::vector<int>> grid(static_cast<size_t>(gridWidth) * gridHeight);
+    std::vector<int> visitedStamp(count, -1);
+
+    auto cellRange = [&](const cv::Rect& r, int& gx0, int& gy0, int& gx1, int& gy1) {
+        gx0 = std::max(0, r.x / cellSize);
+        gy0 = std::max(0, r.y / cellSize);
+        gx1 = std::min(gridWidth - 1, (r.x + std::max(0, r.width - 1)) / cellSize);
+        gy1 = std::min(gridHeight - 1, (r.y + std::max(0, r.height - 1)) / cellSize);
+    };
+
+    // 4. Жадный проход: сравнение только с оставленными рамками из общих ячеек
+    for (int rank = 0; rank < static_cast<int>(order.size()); ++rank) {
+        const int i = order[rank];
+        const cv::Rect& box = shifted[i];
+        int gx0, gy0, gx1, gy1;
+        cellRange(box, gx0, gy0, gx1, gy1);
+
+        bool suppressed = false;
+        for (int gy = gy0; gy <= gy1 && !suppressed; ++gy) {
+            for (int gx = gx0; gx <= gx1 && !suppressed; ++gx) {
+                for (int j : grid[static_cast<size_t>(gy) * gridWidth + gx]) {
+                    if (visitedStamp[j] == rank) continue;
+                    visitedStamp[j] = rank;
+                    if (rectIoU(box, shifted[j]) > options.iouThreshold) {
+                        suppressed = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (suppressed) {
+            continue;
+        }
+
+        keep.push_back(i);
+        for (int gy = gy0; gy <= gy1; ++gy) {
+            for (int gx = gx0; gx <= gx1; ++gx) {
+                grid[static_cast<size_t>(gy) * gridWidth + gx].push_back(i);
+            }
+        }
+    }
+
+    return keep;
+}
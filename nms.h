@@ -0,0 +1,23 @@
+// nms.h - Class-aware non-maximum suppression for dense slides
+#ifndef NMS_H
+#define NMS_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+struct NmsOptions {
+    float iouThreshold = 0.7f;
+    int topK = 0;              // предварительный отбор K лучших по score, 0 = все
+    bool classAware = true;    // рамки разных классов друг друга не подавляют
+};
+
+// Жадный NMS (тот же результат, что cv::dnn::NMSBoxes при score_threshold = 0)
+// с отбором top-K и равномерной сеткой: IoU считается только с оставленными
+// рамками из тех же ячеек, поэтому стоимость почти линейна по числу рамок.
+// Для classAware рамки каждого класса сдвигаются в свою полосу координат и
+// обрабатываются за один проход. classIds может быть пустым (один класс).
+// Возвращает индексы оставленных рамок по убыванию score.
+std::vector<int> nonMaxSuppression(const std::vector<cv::Rect>& boxes, const std::vector<float>& scores,
+                                   const std::vector<int>& classIds, const NmsOptions& options);
+
+#endif // NMS_H
@@ -0,0 +1,104 @@
+// onnxruntimeengine.cpp - ONNX Runtime (CPU) implementation of DetectorEngine
+#include "onnxruntimeengine.h"
+#include "logger.h"
+#include <algorithm>
+#include <stdexcept>
+
+OnnxRuntimeEngine::OnnxRuntimeEngine(const EngineConfig& config)
+    : m_config(config)
+{
+}
+
+Ort::Env& OnnxRuntimeEngine::environment() {
+    static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "CellAnalyzer");
+    return env;
+}
+
+void OnnxRuntimeEngine::load(const QString& modelPath) {
+    Ort::SessionOptions options;
+    if (m_config.intraOpThreads > 0) {
+        options.SetIntraOpNumThreads(m_config.intraOpThreads);
+    }
+    if (m_config.interOpThreads > 1) {
+        options.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+    }
+    options.SetInterOpNumThreads(std::max(1, m_config.interOpThreads));
+
+    GraphOptimizationLevel level = GraphOptimizationLevel::ORT_ENABLE_ALL;
+    switch (m_config.graphOptimizationLevel) {
+    case 0: level = GraphOptimizationLevel::ORT_DISABLE_ALL; break;
+    case 1: level = GraphOptimizationLevel::ORT_ENABLE_BASIC; break;
+    case 2: level = GraphOptimizationLevel::ORT_ENABLE_EXTENDED; break;
+    default: break;
+    }
+    options.SetGraphOptimizationLevel(level);
+
+    try {
+#ifdef _WIN32
+        std::wstring path = modelPath.toStdWString();
+#else
+        std::string path = modelPath.toStdString();
+#endif
+        m_session = std::make_unique<Ort::Session>(environment(), path.c_str(), options);
+    } catch (const Ort::Exception& e) {
+        LOG_ERROR(QString("Failed to load ONNX model in ONNX Runtime: %1").arg(e.what()));
+        throw std::runtime_error("Failed to load ONNX model: " + std::string(e.what()));
+    }
+
+    Ort::AllocatorWithDefaultOptions allocator;
+    m_inputNames.clear();
+    m_outputNames.clear();
+    for (size_t i = 0; i < m_session->GetInputCount(); ++i) {
+        m_inputNames.push_back(m_session->GetInputNameAllocated(i, allocator).get());
+    }
+    for (size_t i = 0; i < m_session->GetOutputCount(); ++i) {
+        m_outputNames.push_back(m_session->GetOutputNameAllocated(i, allocator).get());
+    }
+    m_inputNamePtrs.clear();
+    m_outputNamePtrs.clear();
+    for (const std::string& input : m_inputNames) m_inputNamePtrs.push_back(input.c_str());
+    for (const std::string& output : m_outputNames) m_outputNamePtrs.push_back(output.c_str());
+
+    // [N, 3, H, W]; динамические оси ORT отдает как -1
+    m_inputSize = cv::Size();
+    if (!m_inputNames.empty()) {
+        std::vector<int64_t> shape = m_session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        if (shape.size() == 4 && shape[2] > 0 && shape[3] > 0) {
+            m_inputSize = cv::Size(static_cast<int>(shape[3]), static_cast<int>(shape[2]));
+        }
+    }
+}
+
+EngineIO OnnxRuntimeEngine::describe() const {
+    EngineIO io;
+    io.inputSize = m_inputSize;
+    for (const std::string& input : m_inputNames) io.inputNames.append(QString::fromStdString(input));
+    for (const std::string& output : m_outputNames) io.outputNames.append(QString::fromStdString(output));
+    return io;
+}
+
+std::vector<cv::Mat> OnnxRuntimeEngine::infer(const cv::Mat& blob) {
+    if (!m_session) {
+        throw std::runtime_error("ONNX Runtime session is not loaded");
+    }
+
+    static const Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    std::vector<int64_t> inputShape(blob.size.p, blob.size.p + blob.dims);
+    Ort::Value input = Ort::Value::CreateTensor<float>(
+        memoryInfo, const_cast<float*>(blob.ptr<float>()), blob.total(), inputShape.data(), inputShape.size());
+
+    // Ort::Exception наследует std::exception: вызывающий код обрабатывает
+    // его так же, как ошибку OpenCV (например, откат пакета к N = 1)
+    m_outputs = m_session->Run(Ort::RunOptions{nullptr}, m_inputNamePtrs.data(), &input, 1,
+                               m_outputNamePtrs.data(), m_outputNamePtrs.size());
+
+    std::vector<cv::Mat> outputs;
+    outputs.reserve(m_outputs.size());
+    for (Ort::Value& value : m_outputs) {
+        std::vector<int64_t> shape = value.GetTensorTypeAndShapeInfo().GetShape();
+        std::vector<int> sizes(shape.begin(), shape.end());
+        outputs.emplace_back(static_cast<int>(sizes.size()), sizes.data(), CV_32F,
+                             value.GetTensorMutableData<float>());
+    }
+    return outputs;
+}
@@ -0,0 +1,34 @@
+// onnxruntimeengine.h - ONNX Runtime (CPU) implementation of DetectorEngine
+// Собирается только с -DWITH_ONNXRUNTIME=ON
+#ifndef ONNXRUNTIMEENGINE_H
+#define ONNXRUNTIMEENGINE_H
+
+#include "detectorengine.h"
+#include <onnxruntime_cxx_api.h>
+#include <string>
+
+class OnnxRuntimeEngine : public DetectorEngine {
+public:
+    explicit OnnxRuntimeEngine(const EngineConfig& config);
+
+    QString name() const override { return "ONNX Runtime"; }
+    void load(const QString& modelPath) override;
+    EngineIO describe() const override;
+    std::vector<cv::Mat> infer(const cv::Mat& blob) override;
+
+private:
+    static Ort::Env& environment();
+
+    EngineConfig m_config;
+    std::unique_ptr<Ort::Session> m_session;
+    std::vector<std::string> m_inputNames;
+    std::vector<std::string> m_outputNames;
+    std::vector<const char*> m_inputNamePtrs;
+    std::vector<const char*> m_outputNamePtrs;
+    cv::Size m_inputSize;
+
+    // Выходы последнего прогона: cv::Mat из infer ссылаются на их память
+    std::vector<Ort::Value> m_outputs;
+};
+
+#endif // ONNXRUNTIMEENGINE_H
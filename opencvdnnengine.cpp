@@ -0,0 +1,57 @@
+// opencvdnnengine.cpp - OpenCV DNN implementation of DetectorEngine
+#include "opencvdnnengine.h"
+#include "logger.h"
+#include <stdexcept>
+
+OpenCvDnnEngine::OpenCvDnnEngine(const EngineConfig& config)
+    : m_config(config)
+{
+}
+
+void OpenCvDnnEngine::load(const QString& modelPath) {
+    try {
+        m_net = cv::dnn::readNetFromONNX(modelPath.toStdString());
+    } catch (const cv::Exception& e) {
+        LOG_ERROR(QString("Failed to load ONNX model: %1").arg(e.what()));
+        throw std::runtime_error("Failed to load ONNX model: " + std::string(e.what()));
+    }
+
+    m_net.setPreferableBackend(m_config.backend);
+    m_net.setPreferableTarget(m_config.target);
+    m_outputNames = m_net.getUnconnectedOutLayersNames();
+}
+
+EngineIO OpenCvDnnEngine::describe() const {
+    EngineIO io;
+    io.inputSize = readInputSize();
+    for (const cv::String& output : m_outputNames) {
+        io.outputNames.append(QString::fromStdString(output));
+    }
+    return io;
+}
+
+cv::Size OpenCvDnnEngine::readInputSize() const {
+    // Выход входного слоя (id 0) - формы входов сети, как они объявлены в ONNX.
+    // Динамические оси приходят как 0 или -1.
+    try {
+        std::vector<cv::dnn::MatShape> inShapes, outShapes;
+        m_net.getLayerShapes(cv::dnn::MatShape(), 0, inShapes, outShapes);
+        for (const std::vector<cv::dnn::MatShape>* shapes : {&outShapes, &inShapes}) {
+            for (const cv::dnn::MatShape& shape : *shapes) {
+                if (shape.size() == 4 && shape[2] > 0 && shape[3] > 0) {
+                    return cv::Size(shape[3], shape[2]);
+                }
+            }
+        }
+    } catch (const cv::Exception& e) {
+        LOG_DEBUG(QString("Cannot read ONNX input shape: %1").arg(e.what()));
+    }
+    return cv::Size();
+}
+
+std::vector<cv::Mat> OpenCvDnnEngine::infer(const cv::Mat& blob) {
+    m_net.setInput(blob);
+    std::vector<cv::Mat> outputs;
+    m_net.forward(outputs, m_outputNames);
+    return outputs;
+}
@@ -0,0 +1,25 @@
+// opencvdnnengine.h - OpenCV DNN implementation of DetectorEngine
+#ifndef OPENCVDNNENGINE_H
+#define OPENCVDNNENGINE_H
+
+#include "detectorengine.h"
+#include <opencv2/dnn.hpp>
+
+class OpenCvDnnEngine : public DetectorEngine {
+public:
+    explicit OpenCvDnnEngine(const EngineConfig& config);
+
+    QString name() const override { return "OpenCV DNN"; }
+    void load(const QString& modelPath) override;
+    EngineIO describe() const override;
+    std::vector<cv::Mat> infer(const cv::Mat& blob) override;
+
+private:
+    cv::Size readInputSize() const;
+
+    EngineConfig m_config;
+    cv::dnn::Net m_net;
+    std::vector<cv::String> m_outputNames;
+};
+
+#endif // OPENCVDNNENGINE_H
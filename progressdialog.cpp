@@ -147,6 +147,17 @@ void ProgressDialog::setMessage(const QString& message) {
 
 void ProgressDialog::setProgress(int value) {
     m_progressBar->setValue(value);
+
+    if (m_elapsedTimer.isValid()) {
+        if (!m_progressSamples.isEmpty() && value < m_progressSamples.last().second) {
+            m_progressSamples.clear();
+        }
+        m_progressSamples.append(qMakePair(m_elapsedTimer.elapsed(), value));
+        const int maxSamples = 20;
+        if (m_progressSamples.size() > maxSamples) {
+            m_progressSamples.removeFirst();
+        }
+    }
     
     // Обновляем текст прогресс-бара
     if (m_progressBar->maximum() > 0) {
@@ -184,6 +195,7 @@ void ProgressDialog::showDeterminate(const QString& message, int maximum) {
     setProgress(0);
     
     m_elapsedTimer.start();
+    m_progressSamples.clear();
     m_timeUpdateTimer->start(1000);
     
     show();
@@ -225,6 +237,7 @@ void ProgressDialog::reset() {
     m_logLabel->clear();
     m_logLabel->hide();
     m_timeUpdateTimer->stop();
+    m_progressSamples.clear();
 }
 
 void ProgressDialog::close() {
@@ -251,18 +264,19 @@ void ProgressDialog::updateTimeDisplay() {
     
     QString timeText = QString("Прошло времени: %1").arg(formatTime(elapsed));
     
-    // Добавляем оценку оставшегося времени для определенного прогресса
+    // Добавляем оценку оставшегося времени для определенного прогресса:
+    // по текущей скорости обработки, а не по среднему с момента старта
     if (m_progressBar->maximum() > 0 && m_progressBar->value() > 0) {
         int progress = m_progressBar->value();
         int total = m_progressBar->maximum();
+        double rate = itemsPerSecond();
         
-        if (progress > 0) {
-            qint64 estimatedTotal = (elapsed * total) / progress;
-            qint64 remaining = estimatedTotal - elapsed;
-            
+        if (rate > 0.0) {
+            qint64 remaining = qRound64((total - progress) / rate);
             if (remaining > 0) {
                 timeText += QString(" | Осталось: %1").arg(formatTime(remaining));
             }
+            timeText += QString(" | %1/с").arg(rate, 0, 'f', rate < 10.0 ? 2 : 1);
         }
     } else if (m_estimatedTimeSeconds > 0) {
         timeText += QString(" | Ожидается: %1").arg(formatTime(m_estimatedTimeSeconds));
@@ -271,6 +285,21 @@ void ProgressDialog::updateTimeDisplay() {
     m_timeLabel->setText(timeText);
 }
 
+double ProgressDialog::itemsPerSecond() const {
+    if (m_progressSamples.isEmpty()) {
+        return 0.0;
+    }
+
+    const QPair<qint64, int>& last = m_progressSamples.last();
+    const QPair<qint64, int>& first = m_progressSamples.first();
+    if (m_progressSamples.size() > 1 && last.first > first.first && last.second > first.second) {
+        return (last.second - first.second) * 1000.0 / (last.first - first.first);
+    }
+
+    // Одна точка: средняя скорость с момента старта
+    return last.first > 0 ? last.second * 1000.0 / last.first : 0.0;
+}
+
 QString ProgressDialog::formatTime(qint64 seconds) {
     if (seconds < 60) {
         return QString("%1 сек").arg(seconds);
@@ -10,6 +10,8 @@
 #include <QMovie>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QList>
+#include <QPair>
 
 class ProgressDialog : public QDialog {
     Q_OBJECT
@@ -47,6 +49,7 @@ private:
     void setupUI();
     void updateTimeDisplay();
     QString formatTime(qint64 seconds);
+    double itemsPerSecond() const;
     
 private:
     QProgressBar* m_progressBar;
@@ -63,6 +66,10 @@ private:
     bool m_canceled;
     int m_estimatedTimeSeconds;
     QString m_logMessages;
+
+    // (elapsed ms, progress value) последних обновлений: скорость считается по
+    // скользящему окну, чтобы загрузка модели в начале не искажала оценку
+    QList<QPair<qint64, int>> m_progressSamples;
 };
 
 #endif // PROGRESSDIALOG_H
\ No newline at end of file
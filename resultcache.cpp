@@ -0,0 +1,469 @@
+// resultcache.cpp - Content-addressed on-disk cache of detection results
+#include "resultcache.h"
+#include "settingsmanager.h"
+#include "logger.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QMutexLocker>
+#include <algorithm>
+
+namespace {
+
+const quint32 kMagic = 0x43444554;  // "CDET"
+const quint16 kFormatVersion = 1;
+const quint16 kFlagRawCandidates = 0x1;  // запись - CandidateSet, а не детекции после NMS
+const int kDefaultMaxMB = 512;
+
+// Маска 0/255 -> по биту на пиксель, построчно
+QByteArray packMask(const cv::Mat& mask) {
+    const int bits = mask.rows * mask.cols;
+    QByteArray packed((bits + 7) / 8, '\0');
+    int bit = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar* row = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; ++x, ++bit) {
+            if (row[x]) {
+                packed[bit >> 3] = static_cast<char>(packed[bit >> 3] | (1 << (bit & 7)));
+            }
+        }
+    }
+    return packed;
+}
+
+cv::Mat unpackMask(const QByteArray& packed, int rows, int cols) {
+    cv::Mat mask(rows, cols, CV_8U);
+    int bit = 0;
+    for (int y = 0; y < rows; ++y) {
+        uchar* row = mask.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x, ++bit) {
+            row[x] = (static_cast<uchar>(packed[bit >> 3]) >> (bit & 7)) & 1 ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+void writeMat(QDataStream& stream, const cv::Mat& mat) {
+    // Только непрерывные CV_32F: коэффициенты и прототипы масок
+    stream << qint32(mat.dims);
+    for (int i = 0; i < mat.dims; ++i) {
+        stream << qint32(mat.size[i]);
+    }
+    if (!mat.empty()) {
+        cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+        stream.writeRawData(reinterpret_cast<const char*>(continuous.ptr<float>()),
+                            static_cast<int>(continuous.total() * sizeof(float)));
+    }
+}
+
+bool readMat(QDataStream& stream, qint64 limitBytes, cv::Mat& mat) {
+    qint32 dims = 0;
+    stream >> dims;
+    if (stream.status() != QDataStream::Ok || dims < 0 || dims > 4) {
+        return false;
+    }
+    std::vector<int> sizes(dims);
+    qint64 total = dims > 0 ? 1 : 0;
+    for (int& size : sizes) {
+        qint32 value = 0;
+        stream >> value;
+        if (value < 0) {
+            return false;
+        }
+        size = value;
+        total *= value;
+    }
+    if (stream.status() != QDataStream::Ok || total * qint64(sizeof(float)) > limitBytes) {
+        return false;
+    }
+    if (total == 0) {
+        mat = cv::Mat();
+        return true;
+    }
+    mat.create(dims, sizes.data(), CV_32F);
+    const int bytes = static_cast<int>(total * sizeof(float));
+    return stream.readRawData(reinterpret_cast<char*>(mat.ptr<float>()), bytes) == bytes;
+}
+
+} // namespace
+
+size_t CandidateSet::memoryBytes() const {
+    return boxes.size() * (sizeof(cv::Rect) + sizeof(float) + sizeof(int)) +
+           tileIndices.size() * (sizeof(int) + sizeof(unsigned)) +
+           maskCoefficients.total() * maskCoefficients.elemSize() + protos.total() * protos.elemSize();
+}
+
+ResultCache& ResultCache::instance() {
+    static ResultCache instance;
+    return instance;
+}
+
+ResultCache::ResultCache() {
+    SettingsManager& settings = SettingsManager::instance();
+    m_directory = settings.getValue("resultCache/directory").toString();
+    if (m_directory.isEmpty()) {
+        m_directory = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("detections");
+    }
+    m_maxBytes = settings.getValue("resultCache/maxMB", kDefaultMaxMB).toLongLong() * 1024 * 1024;
+}
+
+QByteArray ResultCache::makeKey(const QByteArray& imageBytes, const QString& modelHash,
+                                const QByteArray& paramsFingerprint) {
+    QCryptographicHash hasher(QCryptographicHash::Sha256);
+    hasher.addData(QByteArray::number(kFormatVersion));
+    hasher.addData(QCryptographicHash::hash(imageBytes, QCryptographicHash::Sha256));
+    hasher.addData(modelHash.toLatin1());
+    hasher.addData(paramsFingerprint);
+    return hasher.result().toHex();
+}
+
+QString ResultCache::entryPath(const QByteArray& key) const {
+    return QDir(m_directory).filePath(QString("%1/%2.det")
+        .arg(QString::fromLatin1(key.left(2)), QString::fromLatin1(key)));
+}
+
+bool ResultCache::lookup(const QByteArray& key, std::vector<CachedDetection>& detections) {
+    return readEntry(key, [&](const QByteArray& data) { return deserialize(data, detections); });
+}
+
+void ResultCache::store(const QByteArray& key, const std::vector<CachedDetection>& detections) {
+    if (maxBytes() > 0) {
+        writeEntry(key, serialize(detections));
+    }
+}
+
+bool ResultCache::lookupCandidates(const QByteArray& key, CandidateSet& candidates) {
+    return readEntry(key, [&](const QByteArray& data) { return deserializeCandidates(data, candidates); });
+}
+
+void ResultCache::storeCandidates(const QByteArray& key, const CandidateSet& candidates) {
+    if (maxBytes() > 0) {
+        writeEntry(key, serializeCandidates(candidates));
+    }
+}
+
+bool ResultCache::readEntry(const QByteArray& key, const std::function<bool(const QByteArray&)>& parse) {
+    const QString path = entryPath(key);
+    QFile file(path);
+    // ReadWrite нужен только для обновления mtime; read-only кэш тоже читается
+    if (!file.open(QIODevice::ReadWrite | QIODevice::ExistingOnly) && !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray data = file.readAll();
+
+    if (!parse(data)) {
+        file.close();
+        LOG_WARNING(QString("Result cache: dropping corrupt entry %1").arg(path));
+        QFile::remove(path);
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            m_totalBytes -= it->size;
+            m_entries.erase(it);
+        }
+        return false;
+    }
+
+    const QDateTime now = QDateTime::currentDateTime();
+    if (file.openMode() & QIODevice::WriteOnly) {
+        file.setFileTime(now, QFileDevice::FileModificationTime);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        it->lastUsedMs = now.toMSecsSinceEpoch();
+    }
+    return true;
+}
+
+void ResultCache::writeEntry(const QByteArray& key, const QByteArray& data) {
+    const QString path = entryPath(key);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // QSaveFile: прерванная запись не оставляет обрезанной записи
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        LOG_WARNING(QString("Result cache: cannot write %1: %2").arg(path, file.errorString()));
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    ensureScanned();
+    EntryInfo& entry = m_entries[key];
+    m_totalBytes += data.size() - entry.size;
+    entry.size = data.size();
+    entry.lastUsedMs = QDateTime::currentMSecsSinceEpoch();
+    evictIfNeeded();
+}
+
+void ResultCache::clear() {
+    QMutexLocker locker(&m_mutex);
+    QDir(m_directory).removeRecursively();
+    m_entries.clear();
+    m_totalBytes = 0;
+    m_scanned = true;
+    LOG_INFO(QString("Result cache cleared: %1").arg(m_directory));
+}
+
+void ResultCache::setMaxBytes(qint64 maxBytes) {
+    QMutexLocker locker(&m_mutex);
+    m_maxBytes = maxBytes;
+    if (m_maxBytes > 0) {
+        ensureScanned();
+        evictIfNeeded();
+    }
+}
+
+qint64 ResultCache::maxBytes() const {
+    QMutexLocker locker(&m_mutex);
+    return m_maxBytes;
+}
+
+qint64 ResultCache::totalBytes() {
+    QMutexLocker locker(&m_mutex);
+    ensureScanned();
+    return m_totalBytes;
+}
+
+void ResultCache::ensureScanned() {
+    if (m_scanned) {
+        return;
+    }
+    m_scanned = true;
+
+    // Записи, оставшиеся от прошлых запусков; время использования - mtime файла
+    QDirIterator it(m_directory, {"*.det"}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        QByteArray key = info.completeBaseName().toLatin1();
+        if (m_entries.contains(key)) {
+            continue;  // уже учтена через store()
+        }
+        EntryInfo entry;
+        entry.size = info.size();
+        entry.lastUsedMs = info.lastModified().toMSecsSinceEpoch();
+        m_entries.insert(key, entry);
+        m_totalBytes += entry.size;
+    }
+    LOG_INFO(QString("Result cache: %1 entries, %2 MB in %3")
+        .arg(m_entries.size()).arg(m_totalBytes / (1024.0 * 1024.0), 0, 'f', 1).arg(m_directory));
+}
+
+void ResultCache::evictIfNeeded() {
+    if (m_totalBytes <= m_maxBytes) {
+        return;
+    }
+
+    // Освобождаем с запасом (до 90% лимита), чтобы не чистить на каждой записи
+    const qint64 target = m_maxBytes / 10 * 9;
+    std::vector<std::pair<qint64, QByteArray>> byAge;
+    byAge.reserve(m_entries.size());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        byAge.emplace_back(it->lastUsedMs, it.key());
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    int evicted = 0;
+    for (const auto& entry : byAge) {
+        if (m_totalBytes <= target) {
+            break;
+        }
+        QFile::remove(entryPath(entry.second));
+        m_totalBytes -= m_entries.value(entry.second).size;
+        m_entries.remove(entry.second);
+        ++evicted;
+    }
+    LOG_INFO(QString("Result cache: evicted %1 least recently used entries").arg(evicted));
+}
+
+// Формат записи (little-endian):
+//   magic u32, version u16, flags u16, count u32
+//   count x { x, y, w, h i32; score f64; classId i32;
+//             maskArea i32; если > 0: equivalentDiameter f64, rows i32, cols i32, биты маски }
+QByteArray ResultCache::serialize(const std::vector<CachedDetection>& detections) {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream << kMagic << kFormatVersion << quint16(0) << quint32(detections.size());
+    for (const CachedDetection& detection : detections) {
+        stream << qint32(detection.box.x) << qint32(detection.box.y)
+               << qint32(detection.box.width) << qint32(detection.box.height)
+               << double(detection.score) << qint32(detection.classId);
+
+        const InstanceMask& mask = detection.mask;
+        if (mask.isEmpty() || mask.mask.empty()) {
+            stream << qint32(0);
+            continue;
+        }
+        stream << qint32(mask.area) << mask.equivalentDiameter
+               << qint32(mask.mask.rows) << qint32(mask.mask.cols);
+        QByteArray bits = packMask(mask.mask);
+        stream.writeRawData(bits.constData(), bits.size());
+    }
+    return data;
+}
+
+bool ResultCache::deserialize(const QByteArray& data, std::vector<CachedDetection>& detections) {
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint16 flags = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> flags >> count;
+    if (stream.status() != QDataStream::Ok || magic != kMagic || version != kFormatVersion ||
+        (flags & kFlagRawCandidates)) {
+        return false;
+    }
+    // Каждая детекция занимает не меньше 32 байт - защита от мусорного count
+    if (count > static_cast<quint32>(data.size() / 32)) {
+        return false;
+    }
+
+    std::vector<CachedDetection> result(count);
+    for (CachedDetection& detection : result) {
+        qint32 x, y, width, height, classId, area;
+        double score;
+        stream >> x >> y >> width >> height >> score >> classId >> area;
+        detection.box = cv::Rect(x, y, width, height);
+        detection.score = static_cast<float>(score);
+        detection.classId = classId;
+
+        if (area > 0) {
+            qint32 rows, cols;
+            stream >> detection.mask.equivalentDiameter >> rows >> cols;
+            if (stream.status() != QDataStream::Ok || rows <= 0 || cols <= 0 ||
+                qint64(rows) * cols > qint64(data.size()) * 8) {
+                return false;
+            }
+            QByteArray bits((qint64(rows) * cols + 7) / 8, '\0');
+            if (stream.readRawData(bits.data(), bits.size()) != bits.size()) {
+                return false;
+            }
+            detection.mask.mask = unpackMask(bits, rows, cols);
+            detection.mask.area = area;
+        }
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+    }
+
+    detections = std::move(result);
+    return true;
+}
+
+// Запись CandidateSet (flags = kFlagRawCandidates):
+//   magic u32, version u16, flags u16, count u32, scoreFloor f64, tiled u8,
+//   imageSize, letterbox (sourceSize, inputSize, scaledSize, scale, padX, padY),
+//   count x { x, y, w, h i32; score f64; classId i32; для тайлов: tileIndex i32, seams u32 },
+//   коэффициенты и прототипы масок: dims i32, размеры, данные float (порядок байт машины)
+QByteArray ResultCache::serializeCandidates(const CandidateSet& candidates) {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    const LetterboxInfo& letterbox = candidates.letterbox;
+    stream << kMagic << kFormatVersion << kFlagRawCandidates << quint32(candidates.size())
+           << double(candidates.scoreFloor) << quint8(candidates.tiled ? 1 : 0)
+           << qint32(candidates.imageSize.width) << qint32(candidates.imageSize.height)
+           << qint32(letterbox.sourceSize.width) << qint32(letterbox.sourceSize.height)
+           << qint32(letterbox.inputSize.width) << qint32(letterbox.inputSize.height)
+           << qint32(letterbox.scaledSize.width) << qint32(letterbox.scaledSize.height)
+           << double(letterbox.scale) << qint32(letterbox.padX) << qint32(letterbox.padY);
+
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const cv::Rect& box = candidates.boxes[i];
+        stream << qint32(box.x) << qint32(box.y) << qint32(box.width) << qint32(box.height)
+               << double(candidates.scores[i]) << qint32(candidates.classIds[i]);
+        if (candidates.tiled) {
+            stream << qint32(candidates.tileIndices[i]) << quint32(candidates.seams[i]);
+        }
+    }
+    writeMat(stream, candidates.maskCoefficients);
+    writeMat(stream, candidates.protos);
+    return data;
+}
+
+bool ResultCache::deserializeCandidates(const QByteArray& data, CandidateSet& candidates) {
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint16 flags = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> flags >> count;
+    if (stream.status() != QDataStream::Ok || magic != kMagic || version != kFormatVersion ||
+        !(flags & kFlagRawCandidates) || count > static_cast<quint32>(data.size() / 28)) {
+        return false;
+    }
+
+    CandidateSet result;
+    double scoreFloor = 0.0;
+    double scale = 1.0;
+    quint8 tiled = 0;
+    qint32 values[10];
+    stream >> scoreFloor >> tiled;
+    for (int i = 0; i < 8; ++i) {
+        stream >> values[i];
+    }
+    stream >> scale >> values[8] >> values[9];
+    result.scoreFloor = static_cast<float>(scoreFloor);
+    result.tiled = tiled != 0;
+    result.imageSize = cv::Size(values[0], values[1]);
+    result.letterbox.sourceSize = cv::Size(values[2], values[3]);
+    result.letterbox.inputSize = cv::Size(values[4], values[5]);
+    result.letterbox.scaledSize = cv::Size(values[6], values[7]);
+    result.letterbox.scale = static_cast<float>(scale);
+    result.letterbox.padX = values[8];
+    result.letterbox.padY = values[9];
+
+    result.boxes.resize(count);
+    result.scores.resize(count);
+    result.classIds.resize(count);
+    if (result.tiled) {
+        result.tileIndices.resize(count);
+        result.seams.resize(count);
+    }
+    for (quint32 i = 0; i < count; ++i) {
+        qint32 x, y, width, height, classId;
+        double score;
+        stream >> x >> y >> width >> height >> score >> classId;
+        result.boxes[i] = cv::Rect(x, y, width, height);
+        result.scores[i] = static_cast<float>(score);
+        result.classIds[i] = classId;
+        if (result.tiled) {
+            qint32 tileIndex;
+            quint32 seams;
+            stream >> tileIndex >> seams;
+            result.tileIndices[i] = tileIndex;
+            result.seams[i] = seams;
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok ||
+        !readMat(stream, data.size(), result.maskCoefficients) ||
+        !readMat(stream, data.size(), result.protos)) {
+        return false;
+    }
+    if (!result.maskCoefficients.empty() && result.maskCoefficients.rows != static_cast<int>(count)) {
+        return false;
+    }
+
+    candidates = std::move(result);
+    return true;
+}
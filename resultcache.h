@@ -0,0 +1,112 @@
+// resultcache.h - Content-addressed on-disk cache of detection results
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include "maskdecoder.h"
+#include <opencv2/core.hpp>
+#include <vector>
+#include <functional>
+
+// Одна детекция после NMS - ровно то, из чего ImageProcessor::buildCells
+// собирает Cell
+struct CachedDetection {
+    cv::Rect box;
+    float score = 0.0f;
+    int classId = 0;
+    InstanceMask mask;  // пустая, если маски не декодировались
+};
+
+// Кандидаты одного изображения до NMS, сжатые до прошедших scoreFloor.
+// Из них ImageProcessor::rethreshold пересчитывает клетки при других
+// confThreshold / iouThreshold / minCellArea без инференса.
+struct CandidateSet {
+    float scoreFloor = 0.0f;           // кандидаты ниже этого score не сохранены
+    cv::Size imageSize;
+    std::vector<cv::Rect> boxes;       // в координатах исходного изображения
+    std::vector<float> scores;
+    std::vector<int> classIds;
+
+    // Маски (кроме тайлового режима): коэффициенты [N x 32] и прототипы
+    // [1, 32, mh, mw] в геометрии letterbox
+    cv::Mat maskCoefficients;
+    cv::Mat protos;
+    LetterboxInfo letterbox;
+
+    // Тайловый режим: тайл и швы каждого кандидата для mergeTileDetections
+    bool tiled = false;
+    std::vector<int> tileIndices;
+    std::vector<unsigned> seams;
+
+    size_t size() const { return boxes.size(); }
+    size_t memoryBytes() const;
+};
+
+// Кэш результатов детекции на диске. Ключ - SHA-256 от содержимого
+// изображения, хэша файла модели и параметров, влияющих на детекции
+// (см. ImageProcessor::cacheFingerprint), поэтому переименованный или
+// скопированный файл тоже попадает в кэш, а измененный - нет.
+//
+// Каждая запись - отдельный файл "<dir>/<2 hex>/<key>.det" в компактном
+// бинарном формате (маски упакованы по биту на пиксель). При превышении
+// лимита удаляются давно не читанные записи (LRU по mtime файла: чтение
+// обновляет mtime, так что порядок переживает перезапуск).
+//
+// Настройки: "resultCache/directory" (по умолчанию CacheLocation/detections)
+// и "resultCache/maxMB" (по умолчанию 512). Потокобезопасен.
+class ResultCache {
+public:
+    static ResultCache& instance();
+
+    static QByteArray makeKey(const QByteArray& imageBytes, const QString& modelHash,
+                              const QByteArray& paramsFingerprint);
+
+    // false - записи нет или она повреждена (поврежденная удаляется)
+    bool lookup(const QByteArray& key, std::vector<CachedDetection>& detections);
+    void store(const QByteArray& key, const std::vector<CachedDetection>& detections);
+
+    // Кандидаты до NMS (YoloParams::spillCandidates); ключ строится без порогов
+    bool lookupCandidates(const QByteArray& key, CandidateSet& candidates);
+    void storeCandidates(const QByteArray& key, const CandidateSet& candidates);
+
+    void clear();
+    void setMaxBytes(qint64 maxBytes);
+    qint64 maxBytes() const;
+    qint64 totalBytes();
+    QString directory() const { return m_directory; }
+
+    // Формат записи на диске (см. resultcache.cpp). false - данные
+    // повреждены или обрезаны; выходной аргумент при этом не меняется.
+    static QByteArray serialize(const std::vector<CachedDetection>& detections);
+    static bool deserialize(const QByteArray& data, std::vector<CachedDetection>& detections);
+    static QByteArray serializeCandidates(const CandidateSet& candidates);
+    static bool deserializeCandidates(const QByteArray& data, CandidateSet& candidates);
+
+private:
+    ResultCache();
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    struct EntryInfo {
+        qint64 size = 0;
+        qint64 lastUsedMs = 0;
+    };
+
+    QString entryPath(const QByteArray& key) const;
+    bool readEntry(const QByteArray& key, const std::function<bool(const QByteArray&)>& parse);
+    void writeEntry(const QByteArray& key, const QByteArray& data);
+    void ensureScanned();     // под m_mutex
+    void evictIfNeeded();     // под m_mutex
+
+    QString m_directory;
+    qint64 m_maxBytes = 0;
+    qint64 m_totalBytes = 0;
+    bool m_scanned = false;
+    QHash<QByteArray, EntryInfo> m_entries;  // key -> размер и время последнего использования
+    mutable QMutex m_mutex;
+};
+
+#endif // RESULTCACHE_H
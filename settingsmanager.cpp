@@ -7,6 +7,7 @@
 #include <QFile>
 #include <QDebug>
 #include <QCoreApplication>
+#include <QMutexLocker>
 #include "logger.h"
 
 SettingsManager& SettingsManager::instance() {
@@ -34,8 +35,27 @@ QString SettingsManager::getSettingsPath() const {
     return QDir(appDir).filePath(m_settingsFile);
 }
 
+namespace {
+
+// Записывает value по пути keys[index..] с созданием промежуточных объектов
+void setNestedValue(QJsonObject& object, const QStringList& keys, int index, const QJsonValue& value) {
+    const QString& key = keys[index];
+    if (index == keys.size() - 1) {
+        object[key] = value;
+        return;
+    }
+    QJsonObject child = object[key].toObject();
+    setNestedValue(child, keys, index + 1, value);
+    object[key] = child;
+}
+
+} // namespace
+
 void SettingsManager::saveSettings() {
-    QJsonObject root;
+    QMutexLocker locker(&m_mutex);
+
+    // Начинаем с загруженного объекта, чтобы не потерять общие настройки (setValue)
+    QJsonObject root = m_settings;
 
     // Сохраняем размер превью
     root["previewSize"] = m_previewSize;
@@ -50,6 +70,8 @@ void SettingsManager::saveSettings() {
     // Сохраняем тему
     root["Theme"] = m_theme;
 
+    m_settings = root;
+
     // Записываем в файл
     QJsonDocument doc(root);
     QFile file(getSettingsPath());
@@ -63,6 +85,7 @@ void SettingsManager::saveSettings() {
 }
 
 void SettingsManager::loadSettings() {
+    QMutexLocker locker(&m_mutex);
     QFile file(getSettingsPath());
     if (!file.exists()) {
         LOG_INFO("Settings file not found, using defaults");
@@ -138,6 +161,7 @@ void SettingsManager::setTheme(const QString& theme) {
 }
 
 QVariant SettingsManager::getValue(const QString& key, const QVariant& defaultValue) const {
+    QMutexLocker locker(&m_mutex);
     const_cast<SettingsManager*>(this)->loadSettings();
 
     QStringList keys = key.split('/');
@@ -164,30 +188,23 @@ QVariant SettingsManager::getValue(const QString& key, const QVariant& defaultVa
 }
 
 void SettingsManager::setValue(const QString& key, const QVariant& value) {
+    QMutexLocker locker(&m_mutex);
     loadSettings();
 
     QStringList keys = key.split('/');
-    QJsonObject* current = &m_settings;
 
-    // Navigate to the correct location
-    for (int i = 0; i < keys.size() - 1; i++) {
-        if (!current->contains(keys[i]) || !(*current)[keys[i]].isObject()) {
-            (*current)[keys[i]] = QJsonObject();
-        }
-        QJsonObject temp = (*current)[keys[i]].toObject();
-        (*current)[keys[i]] = temp;
-        current = &temp;
-    }
-
-    // Set the value
-    QString lastKey = keys.last();
+    QJsonValue jsonValue;
     if (value.type() == QVariant::Bool) {
-        (*current)[lastKey] = value.toBool();
-    } else if (value.type() == QVariant::Double || value.type() == QVariant::Int) {
-        (*current)[lastKey] = value.toDouble();
+        jsonValue = value.toBool();
+    } else if (value.type() == QVariant::Double || value.type() == QVariant::Int ||
+               value.type() == QVariant::LongLong) {
+        jsonValue = value.toDouble();
     } else {
-        (*current)[lastKey] = value.toString();
+        jsonValue = value.toString();
     }
 
+    // Nested keys ("a/b/c") are written into nested JSON objects
+    setNestedValue(m_settings, keys, 0, jsonValue);
+
     saveSettings();
 }
@@ -5,6 +5,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QVariant>
+#include <QRecursiveMutex>
 
 class SettingsManager {
 public:
@@ -53,6 +54,7 @@ private:
     QString m_theme = "Dark";
     QString m_settingsFile = "settings.json";
     mutable QJsonObject m_settings;
+    mutable QRecursiveMutex m_mutex;  // getValue/setValue вызываются и из рабочих потоков
 };
 
 #endif // SETTINGSMANAGER_H
\ No newline at end of file
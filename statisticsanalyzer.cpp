@@ -2,7 +2,7 @@
 #include "logger.h"
 #include <algorithm>
 #include <cmath>
-#include <QFileInfo>
+#include <QHash>
 
 StatisticsAnalyzer::StatisticsAnalyzer() {
 }
@@ -11,18 +11,22 @@ StatisticsAnalyzer::~StatisticsAnalyzer() {
 }
 
 StatisticsAnalyzer::ComprehensiveAnalysis StatisticsAnalyzer::analyzeAllCells(const QVector<Cell>& cells) {
+    return analyzeAllCells(CellTable(cells));
+}
+
+StatisticsAnalyzer::ComprehensiveAnalysis StatisticsAnalyzer::analyzeAllCells(const CellTable& table) {
     ComprehensiveAnalysis analysis;
     
-    if (cells.isEmpty()) {
+    if (table.isEmpty()) {
         Logger::instance().log("StatisticsAnalyzer: Нет клеток для анализа", LogLevel::WARNING);
         return analysis;
     }
     
-    Logger::instance().log(QString("StatisticsAnalyzer: Начинаем анализ %1 клеток").arg(cells.size()));
+    Logger::instance().log(QString("StatisticsAnalyzer: Начинаем анализ %1 клеток").arg(table.size()));
     
     // Извлекаем данные только в микрометрах
-    QVector<double> diametersUm = extractDiameters(cells);
-    QVector<double> areasUm2 = extractAreas(cells);
+    QVector<double> diametersUm = extractDiameters(table);
+    QVector<double> areasUm2 = extractAreas(table);
     
     // Проверяем что есть данные в микрометрах
     if (diametersUm.isEmpty() || std::all_of(diametersUm.begin(), diametersUm.end(), [](double d) { return d <= 0.0; })) {
@@ -40,11 +44,15 @@ StatisticsAnalyzer::ComprehensiveAnalysis StatisticsAnalyzer::analyzeAllCells(co
     
     // Группировка по изображениям
     analysis.imageGroupCounts = QMap<QString, int>();
-    analysis.imageGroupStats = analyzeByImageGroups(cells);
-    
-    QMap<QString, QVector<Cell>> imageGroups = groupCellsByImage(cells);
-    for (auto it = imageGroups.begin(); it != imageGroups.end(); ++it) {
-        analysis.imageGroupCounts[it.key()] = it.value().size();
+    analysis.imageGroupStats = analyzeByImageGroups(table);
+    
+    const ImageCatalog::Grouping grouping = table.groupByImage();
+    QStringList groupNames;
+    std::vector<int> groupOfImage = imageGroups(grouping, groupNames);
+    for (int id = 0; id < grouping.idCount(); ++id) {
+        if (groupOfImage[id] >= 0) {
+            analysis.imageGroupCounts[groupNames[groupOfImage[id]]] += grouping.count(id);
+        }
     }
     
     // Обнаружение выбросов (только по диаметрам в микрометрах)
@@ -183,39 +191,97 @@ StatisticsAnalyzer::Distribution StatisticsAnalyzer::createDistribution(const QV
 }
 
 StatisticsAnalyzer::BasicStatistics StatisticsAnalyzer::analyzeDiameters(const QVector<Cell>& cells) {
-    QVector<double> diameters = extractDiameters(cells);
-    return calculateBasicStatistics(diameters);
+    return analyzeDiameters(CellTable(cells));
 }
 
 StatisticsAnalyzer::BasicStatistics StatisticsAnalyzer::analyzeAreas(const QVector<Cell>& cells) {
-    QVector<double> areas = extractAreas(cells);
+    return analyzeAreas(CellTable(cells));
+}
+
+StatisticsAnalyzer::BasicStatistics StatisticsAnalyzer::analyzeDiameters(const CellTable& table) {
+    QVector<double> diameters = extractDiameters(table);
+    return calculateBasicStatistics(diameters);
+}
+
+StatisticsAnalyzer::BasicStatistics StatisticsAnalyzer::analyzeAreas(const CellTable& table) {
+    QVector<double> areas = extractAreas(table);
     return calculateBasicStatistics(areas);
 }
 
 
 QMap<QString, QVector<Cell>> StatisticsAnalyzer::groupCellsByImage(const QVector<Cell>& cells) {
-    QMap<QString, QVector<Cell>> groups;
-    
+    std::vector<int> imageIds;
+    imageIds.reserve(cells.size());
     for (const Cell& cell : cells) {
-        QString imageName = QFileInfo(QString::fromStdString(cell.imagePath)).baseName();
-        groups[imageName].append(cell);
+        imageIds.push_back(cell.imageId);
+    }
+
+    // Подсчетом по id изображения; имя группы - одно на изображение
+    const ImageCatalog::Grouping grouping = ImageCatalog::groupByImage(imageIds);
+    QMap<QString, QVector<Cell>> groups;
+    for (int id = 0; id < grouping.idCount(); ++id) {
+        if (grouping.count(id) == 0) {
+            continue;
+        }
+        QVector<Cell>& group = groups[ImageCatalog::instance().baseName(id)];
+        for (const int* index = grouping.begin(id); index != grouping.end(id); ++index) {
+            group.append(cells[*index]);
+        }
     }
     
     return groups;
 }
 
 QMap<QString, StatisticsAnalyzer::BasicStatistics> StatisticsAnalyzer::analyzeByImageGroups(const QVector<Cell>& cells) {
+    return analyzeByImageGroups(CellTable(cells));
+}
+
+QMap<QString, StatisticsAnalyzer::BasicStatistics> StatisticsAnalyzer::analyzeByImageGroups(const CellTable& table) {
+    const ImageCatalog::Grouping grouping = table.groupByImage();
+    QStringList groupNames;
+    std::vector<int> groupOfImage = imageGroups(grouping, groupNames);
+
+    std::vector<QVector<double>> diameters(groupNames.size());
+    const double* diameterUm = table.diameterUm.data();
+    for (int id = 0; id < grouping.idCount(); ++id) {
+        if (groupOfImage[id] < 0) {
+            continue;
+        }
+        QVector<double>& group = diameters[groupOfImage[id]];
+        for (const int* row = grouping.begin(id); row != grouping.end(id); ++row) {
+            if (diameterUm[*row] > 0) {
+                group.append(diameterUm[*row]);
+            }
+        }
+    }
+
     QMap<QString, BasicStatistics> groupStats;
-    QMap<QString, QVector<Cell>> groups = groupCellsByImage(cells);
-    
-    for (auto it = groups.begin(); it != groups.end(); ++it) {
-        QVector<double> diameters = extractDiameters(it.value());
-        groupStats[it.key()] = calculateBasicStatistics(diameters);
+    for (int g = 0; g < groupNames.size(); ++g) {
+        groupStats[groupNames[g]] = calculateBasicStatistics(diameters[g]);
     }
     
     return groupStats;
 }
 
+std::vector<int> StatisticsAnalyzer::imageGroups(const ImageCatalog::Grouping& grouping, QStringList& groupNames) {
+    // Разные пути с одинаковым baseName попадают в одну группу
+    QHash<QString, int> groupIndex;
+    std::vector<int> groupOfImage(grouping.idCount(), -1);
+    for (int id = 0; id < grouping.idCount(); ++id) {
+        if (grouping.count(id) == 0) {
+            continue;
+        }
+        QString name = ImageCatalog::instance().baseName(id);
+        auto it = groupIndex.constFind(name);
+        if (it == groupIndex.constEnd()) {
+            it = groupIndex.insert(name, groupNames.size());
+            groupNames.append(name);
+        }
+        groupOfImage[id] = *it;
+    }
+    return groupOfImage;
+}
+
 QVector<int> StatisticsAnalyzer::detectOutliers(const QVector<double>& values, double threshold) {
     return detectOutliersIQR(values, threshold);
 }
@@ -445,32 +511,27 @@ double StatisticsAnalyzer::calculatePercentile(const QVector<double>& sortedValu
     return sortedValues[lowerIndex] * (1.0 - weight) + sortedValues[upperIndex] * weight;
 }
 
-QVector<double> StatisticsAnalyzer::extractDiameters(const QVector<Cell>& cells) {
+QVector<double> StatisticsAnalyzer::extractDiameters(const CellTable& table) {
+    // Используем только diameter_um (микрометры)
     QVector<double> diameters;
-    int validCells = 0;
-    int zeroCells = 0;
-    
-    for (const Cell& cell : cells) {
-        // Используем только diameter_um (микрометры)
-        if (cell.diameter_um > 0) {
-            diameters.append(cell.diameter_um);
-            validCells++;
-        } else {
-            zeroCells++;
+    diameters.reserve(table.size());
+    for (double diameterUm : table.diameterUm) {
+        if (diameterUm > 0) {
+            diameters.append(diameterUm);
         }
     }
     
-    
     return diameters;
 }
 
-QVector<double> StatisticsAnalyzer::extractAreas(const QVector<Cell>& cells) {
+QVector<double> StatisticsAnalyzer::extractAreas(const CellTable& table) {
     QVector<double> areas;
+    areas.reserve(table.size());
     
-    for (const Cell& cell : cells) {
+    for (double diameterUm : table.diameterUm) {
         // Вычисляем площадь в мкм² на основе diameter_um
-        if (cell.diameter_um > 0) {
-            double radius_um = cell.diameter_um / 2.0;
+        if (diameterUm > 0) {
+            double radius_um = diameterUm / 2.0;
             double area_um2 = M_PI * radius_um * radius_um;
             areas.append(area_um2);
         }
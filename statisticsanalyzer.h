@@ -5,6 +5,8 @@
 #include <QString>
 #include <QMap>
 #include "cell.h"
+#include "celltable.h"
+#include <vector>
 
 class StatisticsAnalyzer {
 public:
@@ -61,18 +63,23 @@ public:
     StatisticsAnalyzer();
     ~StatisticsAnalyzer();
     
-    // Основные функции анализа
+    // Основные функции анализа. Вариант с CellTable читает только столбцы
+    // диаметра и изображения; вариант с QVector<Cell> строит таблицу сам
     ComprehensiveAnalysis analyzeAllCells(const QVector<Cell>& cells);
+    ComprehensiveAnalysis analyzeAllCells(const CellTable& table);
     BasicStatistics calculateBasicStatistics(const QVector<double>& values);
     Distribution createDistribution(const QVector<double>& values, int binCount = 10);
     
     // Статистики отдельных параметров (только микрометры)
     BasicStatistics analyzeDiameters(const QVector<Cell>& cells);
     BasicStatistics analyzeAreas(const QVector<Cell>& cells);
+    BasicStatistics analyzeDiameters(const CellTable& table);
+    BasicStatistics analyzeAreas(const CellTable& table);
     
     // Группировка по изображениям
     QMap<QString, QVector<Cell>> groupCellsByImage(const QVector<Cell>& cells);
     QMap<QString, BasicStatistics> analyzeByImageGroups(const QVector<Cell>& cells);
+    QMap<QString, BasicStatistics> analyzeByImageGroups(const CellTable& table);
     
     // Обнаружение выбросов
     QVector<int> detectOutliers(const QVector<double>& values, double threshold = 1.5);
@@ -100,8 +107,12 @@ public:
     
 private:
     // Вспомогательные функции
-    QVector<double> extractDiameters(const QVector<Cell>& cells);
-    QVector<double> extractAreas(const QVector<Cell>& cells);
+    QVector<double> extractDiameters(const CellTable& table);
+    QVector<double> extractAreas(const CellTable& table);
+
+    // Группа (baseName файла) каждого id изображения: индекс в groupNames,
+    // -1 для id без клеток
+    static std::vector<int> imageGroups(const ImageCatalog::Grouping& grouping, QStringList& groupNames);
     
     QString createSummary(const ComprehensiveAnalysis& analysis);
     QString analyzeDistributionShape(const BasicStatistics& stats);
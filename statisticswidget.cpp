@@ -1,6 +1,7 @@
 #include "statisticswidget.h"
 #include "logger.h"
 #include "settingsmanager.h"
+#include "imagecatalog.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QHeaderView>
@@ -382,7 +383,7 @@ void StatisticsWidget::populateOutliersTab(const StatisticsAnalyzer::Comprehensi
         double area_um2 = M_PI * (cell.diameter_um / 2.0) * (cell.diameter_um / 2.0);
         outliersTable->setItem(rowIndex, 2, new QTableWidgetItem(formatStatValue(area_um2)));
         
-        QString imageName = QFileInfo(QString::fromStdString(cell.imagePath)).baseName();
+        QString imageName = ImageCatalog::instance().baseName(cell.imageId);
         outliersTable->setItem(rowIndex, 3, new QTableWidgetItem(imageName));
         
         // Z-score для диаметра (в микрометрах)
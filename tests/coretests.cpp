@@ -0,0 +1,416 @@
+// coretests.cpp - Self-tests: grid NMS vs brute force, result cache format, Cell copy cost
+#include "nms.h"
+#include "resultcache.h"
+#include "cell.h"
+#include "celltable.h"
+#include "imagecatalog.h"
+#include <QVector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <numeric>
+#include <random>
+#include <string>
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        ++g_failures;
+        std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+    }
+}
+
+// ---------------------------------------------------------------------------
+// NMS: эталон - жадный перебор всех пар с тем же порядком и тем же IoU
+
+float bruteIoU(const cv::Rect& a, const cv::Rect& b) {
+    int inter = (a & b).area();
+    if (inter <= 0) return 0.0f;
+    int uni = a.area() + b.area() - inter;
+    return uni > 0 ? static_cast<float>(inter) / uni : 0.0f;
+}
+
+std::vector<int> bruteForceNms(const std::vector<cv::Rect>& boxes, const std::vector<float>& scores,
+                               const std::vector<int>& classIds, const NmsOptions& options) {
+    std::vector<int> order(boxes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+    if (options.topK > 0 && options.topK < static_cast<int>(order.size())) {
+        order.resize(options.topK);
+    }
+
+    const bool byClass = options.classAware && classIds.size() == boxes.size();
+    std::vector<int> keep;
+    for (int i : order) {
+        bool suppressed = false;
+        for (int j : keep) {
+            if (byClass && std::max(0, classIds[i]) != std::max(0, classIds[j])) continue;
+            if (bruteIoU(boxes[i], boxes[j]) > options.iouThreshold) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) {
+            keep.push_back(i);
+        }
+    }
+    return keep;
+}
+
+void testNmsMatchesBruteForce() {
+    std::mt19937 rng(20240611);
+    const float thresholds[] = {0.3f, 0.5f, 0.7f};
+    int cases = 0;
+
+    for (int round = 0; round < 400; ++round) {
+        // Скопления вокруг нескольких центров - много перекрытий, как на плотном препарате
+        const int count = std::uniform_int_distribution<int>(0, 300)(rng);
+        const int clusters = std::uniform_int_distribution<int>(1, 8)(rng);
+        const int extent = std::uniform_int_distribution<int>(50, 4000)(rng);
+        const int maxSize = std::uniform_int_distribution<int>(4, 120)(rng);
+        const int classes = std::uniform_int_distribution<int>(1, 4)(rng);
+
+        std::vector<cv::Point> centers;
+        for (int c = 0; c < clusters; ++c) {
+            centers.emplace_back(std::uniform_int_distribution<int>(-extent / 4, extent)(rng),
+                                 std::uniform_int_distribution<int>(-extent / 4, extent)(rng));
+        }
+
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        std::vector<int> classIds;
+        std::normal_distribution<float> jitter(0.0f, maxSize * 0.4f);
+        for (int i = 0; i < count; ++i) {
+            const cv::Point& center = centers[std::uniform_int_distribution<int>(0, clusters - 1)(rng)];
+            const int width = std::uniform_int_distribution<int>(1, maxSize)(rng);
+            const int height = std::uniform_int_distribution<int>(1, maxSize)(rng);
+            boxes.emplace_back(center.x + static_cast<int>(jitter(rng)) - width / 2,
+                               center.y + static_cast<int>(jitter(rng)) - height / 2, width, height);
+            // Грубый шаг score дает много равных значений - проверка порядка при равенстве
+            scores.push_back(std::uniform_int_distribution<int>(1, 20)(rng) * 0.05f);
+            classIds.push_back(std::uniform_int_distribution<int>(0, classes - 1)(rng));
+        }
+
+        for (float threshold : thresholds) {
+            for (int variant = 0; variant < 4; ++variant) {
+                NmsOptions options;
+                options.iouThreshold = threshold;
+                options.classAware = variant != 1;
+                options.topK = variant == 3 ? count / 2 : 0;
+                const std::vector<int> ids = variant == 2 ? std::vector<int>() : classIds;
+
+                std::vector<int> expected = bruteForceNms(boxes, scores, ids, options);
+                std::vector<int> actual = nonMaxSuppression(boxes, scores, ids, options);
+                check(actual == expected,
+                      "nms round " + std::to_string(round) + " threshold " + std::to_string(threshold) +
+                      " variant " + std::to_string(variant) + ": " + std::to_string(actual.size()) +
+                      " kept, expected " + std::to_string(expected.size()));
+                ++cases;
+            }
+        }
+    }
+    std::printf("nms: %d cases\n", cases);
+}
+
+// ---------------------------------------------------------------------------
+// ResultCache: serialize -> deserialize дает те же данные, обрезанная запись отвергается
+
+cv::Mat randomMask(std::mt19937& rng, int rows, int cols) {
+    cv::Mat mask(rows, cols, CV_8U);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            mask.at<uchar>(y, x) = (rng() & 1) ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+bool sameMat(const cv::Mat& a, const cv::Mat& b) {
+    if (a.empty() || b.empty()) {
+        return a.empty() && b.empty();
+    }
+    if (a.dims != b.dims || a.type() != b.type() || a.total() != b.total()) {
+        return false;
+    }
+    for (int i = 0; i < a.dims; ++i) {
+        if (a.size[i] != b.size[i]) return false;
+    }
+    cv::Mat ca = a.isContinuous() ? a : a.clone();
+    cv::Mat cb = b.isContinuous() ? b : b.clone();
+    return std::equal(ca.datastart, ca.dataend, cb.datastart);
+}
+
+void testDetectionsRoundTrip() {
+    std::mt19937 rng(7);
+    std::vector<CachedDetection> detections;
+    for (int i = 0; i < 12; ++i) {
+        CachedDetection detection;
+        // Нечетные размеры - маска не кратна байту
+        detection.box = cv::Rect(i * 17 - 5, i * 3, 3 + i * 2, 5 + i);
+        detection.score = 0.1f + 0.07f * i;
+        detection.classId = i % 3;
+        if (i % 4 != 0) {
+            detection.mask.mask = randomMask(rng, detection.box.height, detection.box.width);
+            detection.mask.area = cv::countNonZero(detection.mask.mask);
+            detection.mask.equivalentDiameter = 1.5 + i;
+        }
+        detections.push_back(detection);
+    }
+
+    const QByteArray data = ResultCache::serialize(detections);
+    std::vector<CachedDetection> restored;
+    check(ResultCache::deserialize(data, restored), "detections: deserialize failed");
+    check(restored.size() == detections.size(), "detections: count differs");
+    for (size_t i = 0; i < std::min(restored.size(), detections.size()); ++i) {
+        const CachedDetection& a = detections[i];
+        const CachedDetection& b = restored[i];
+        const std::string at = "detections[" + std::to_string(i) + "]: ";
+        check(a.box == b.box, at + "box");
+        check(a.score == b.score, at + "score");
+        check(a.classId == b.classId, at + "classId");
+        check(a.mask.area == b.mask.area, at + "mask area");
+        check(a.mask.equivalentDiameter == b.mask.equivalentDiameter, at + "equivalentDiameter");
+        check(sameMat(a.mask.mask, b.mask.mask), at + "mask pixels");
+    }
+
+    std::vector<CachedDetection> empty;
+    check(ResultCache::deserialize(ResultCache::serialize(empty), restored) && restored.empty(),
+          "detections: empty list");
+
+    // Любой обрезанный префикс - ошибка, а выходной вектор не меняется
+    std::vector<CachedDetection> untouched(1);
+    for (int length = 0; length < data.size(); ++length) {
+        if (ResultCache::deserialize(data.left(length), untouched)) {
+            check(false, "detections: truncated to " + std::to_string(length) + " bytes accepted");
+            break;
+        }
+    }
+    check(untouched.size() == 1, "detections: output modified on failure");
+
+    QByteArray badMagic = data;
+    badMagic[0] = static_cast<char>(badMagic[0] ^ 0xFF);
+    check(!ResultCache::deserialize(badMagic, restored), "detections: bad magic accepted");
+
+    CandidateSet candidates;
+    check(!ResultCache::deserializeCandidates(data, candidates), "detections read as candidates");
+}
+
+void testCandidatesRoundTrip(bool tiled) {
+    std::mt19937 rng(tiled ? 11 : 13);
+    std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+    const std::string tag = tiled ? "tiled candidates: " : "candidates: ";
+
+    CandidateSet candidates;
+    candidates.scoreFloor = 0.05f;
+    candidates.tiled = tiled;
+    candidates.imageSize = cv::Size(2048, 1536);
+    candidates.letterbox.sourceSize = candidates.imageSize;
+    candidates.letterbox.inputSize = cv::Size(640, 640);
+    candidates.letterbox.scaledSize = cv::Size(640, 480);
+    candidates.letterbox.scale = 0.3125f;
+    candidates.letterbox.padX = 0;
+    candidates.letterbox.padY = 80;
+
+    const int count = 37;
+    for (int i = 0; i < count; ++i) {
+        candidates.boxes.emplace_back(i * 31, i * 7, 20 + i, 18 + i % 5);
+        candidates.scores.push_back(0.05f + i * 0.02f);
+        candidates.classIds.push_back(i % 2);
+        if (tiled) {
+            candidates.tileIndices.push_back(i % 6);
+            candidates.seams.push_back(static_cast<unsigned>(i % 16));
+        }
+    }
+    if (!tiled) {
+        candidates.maskCoefficients.create(count, 32, CV_32F);
+        for (int y = 0; y < count; ++y) {
+            for (int x = 0; x < 32; ++x) {
+                candidates.maskCoefficients.at<float>(y, x) = value(rng);
+            }
+        }
+        const int protoSizes[] = {1, 32, 20, 20};
+        candidates.protos.create(4, protoSizes, CV_32F);
+        float* proto = candidates.protos.ptr<float>();
+        for (size_t i = 0; i < candidates.protos.total(); ++i) {
+            proto[i] = value(rng);
+        }
+    }
+
+    const QByteArray data = ResultCache::serializeCandidates(candidates);
+    CandidateSet restored;
+    check(ResultCache::deserializeCandidates(data, restored), tag + "deserialize failed");
+    check(restored.scoreFloor == candidates.scoreFloor, tag + "scoreFloor");
+    check(restored.tiled == candidates.tiled, tag + "tiled");
+    check(restored.imageSize == candidates.imageSize, tag + "imageSize");
+    check(restored.letterbox.sourceSize == candidates.letterbox.sourceSize &&
+          restored.letterbox.inputSize == candidates.letterbox.inputSize &&
+          restored.letterbox.scaledSize == candidates.letterbox.scaledSize &&
+          restored.letterbox.scale == candidates.letterbox.scale &&
+          restored.letterbox.padX == candidates.letterbox.padX &&
+          restored.letterbox.padY == candidates.letterbox.padY, tag + "letterbox");
+    check(restored.boxes == candidates.boxes, tag + "boxes");
+    check(restored.scores == candidates.scores, tag + "scores");
+    check(restored.classIds == candidates.classIds, tag + "classIds");
+    check(restored.tileIndices == candidates.tileIndices, tag + "tileIndices");
+    check(restored.seams == candidates.seams, tag + "seams");
+    check(sameMat(restored.maskCoefficients, candidates.maskCoefficients), tag + "maskCoefficients");
+    check(sameMat(restored.protos, candidates.protos), tag + "protos");
+
+    CandidateSet untouched;
+    untouched.scoreFloor = -1.0f;
+    for (int length = 0; length < data.size(); ++length) {
+        if (ResultCache::deserializeCandidates(data.left(length), untouched)) {
+            check(false, tag + "truncated to " + std::to_string(length) + " bytes accepted");
+            break;
+        }
+    }
+    check(untouched.scoreFloor == -1.0f && untouched.size() == 0, tag + "output modified on failure");
+
+    std::vector<CachedDetection> detections;
+    check(!ResultCache::deserialize(data, detections), tag + "read as detections");
+}
+
+// ---------------------------------------------------------------------------
+// Cell: копии по пути анализ -> проверка -> статистика делят пиксели.
+// Печатает для того же набора копий число клонов cv::Mat и время при прежней
+// семантике (маска клонировалась при каждом копировании Cell) и при текущей.
+
+struct FlowResult {
+    long long cellCopies = 0;
+    std::vector<QVector<Cell>> outputs;
+};
+
+// Те же копирования, что делают MainWindow, VerificationWidget и StatisticsWidget:
+// отделение QVector при неконстантном доступе, раскладка по файлам, CellTable с
+// payload и обратно, копия для статистики
+FlowResult runCopyFlow(const QVector<Cell>& cells) {
+    const Cell::CopyStats before = Cell::copyStats();
+    FlowResult result;
+
+    QVector<Cell> verification = cells;
+    verification.detach();
+    result.outputs.push_back(verification);
+    result.outputs.back().detach();
+
+    std::vector<int> imageIds;
+    for (const Cell& cell : verification) {
+        imageIds.push_back(cell.imageId);
+    }
+    const ImageCatalog::Grouping grouping = ImageCatalog::groupByImage(imageIds);
+    for (int id = 0; id < grouping.idCount(); ++id) {
+        QVector<Cell> fileCells;
+        for (const int* i = grouping.begin(id); i != grouping.end(id); ++i) {
+            fileCells.append(verification[*i]);
+        }
+        if (!fileCells.isEmpty()) {
+            result.outputs.push_back(fileCells);
+        }
+    }
+
+    CellTable table(verification, true);
+    result.outputs.push_back(table.toCells());
+
+    QVector<Cell> statistics = verification;
+    statistics.detach();
+    result.outputs.push_back(statistics);
+
+    result.cellCopies = Cell::copyStats().copies - before.copies;
+    return result;
+}
+
+void testCellCopiesSharePixels() {
+    // 6 снимков 2048x1536, по 500 клеток с маской 48x48 и фрагментом 56x56,
+    // как после ImageProcessor::finalizeCells
+    std::mt19937 rng(3);
+    QVector<Cell> cells;
+    std::vector<cv::Mat> sources;
+    for (int image = 0; image < 6; ++image) {
+        sources.emplace_back(1536, 2048, CV_8UC3, cv::Scalar(40, 80, 120));
+        const int imageId = ImageCatalog::instance().intern(QString("/slides/slide_%1.png").arg(image));
+        for (int i = 0; i < 500; ++i) {
+            Cell cell;
+            cell.bbox_x = std::uniform_int_distribution<int>(0, 1990)(rng);
+            cell.bbox_y = std::uniform_int_distribution<int>(0, 1478)(rng);
+            cell.bbox_width = 48;
+            cell.bbox_height = 48;
+            cell.mask = randomMask(rng, 48, 48);
+            cell.image = sources.back()(cv::Rect(cell.bbox_x, cell.bbox_y, 56, 56) &
+                                        cv::Rect(0, 0, 2048, 1536)).clone();
+            cell.imageId = imageId;
+            cells.append(cell);
+        }
+    }
+
+    Cell::resetCopyStats();
+    auto started = std::chrono::steady_clock::now();
+    FlowResult flow = runCopyFlow(cells);
+    const double sharedMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    // Каждая копия должна указывать на буферы исходной клетки
+    std::map<const uchar*, const uchar*> cropByMask;
+    for (const Cell& cell : cells) {
+        cropByMask[cell.mask.data] = cell.image.data;
+    }
+    bool shared = true;
+    for (const QVector<Cell>& output : flow.outputs) {
+        for (const Cell& cell : output) {
+            auto it = cropByMask.find(cell.mask.data);
+            shared = shared && it != cropByMask.end() && it->second == cell.image.data;
+        }
+    }
+    check(flow.cellCopies > 0, "cell copies: flow made no copies");
+    check(shared, "cell copies: a copy does not share the mask or crop buffer");
+    check(Cell::copyStats().pixelCopies == 0, "cell copies: pixel buffers detached without mutable access");
+
+    // Прежняя семантика: клон маски на каждую копию Cell (фрагмент копировался заголовком)
+    long long oldClones = 0;
+    long long oldBytes = 0;
+    started = std::chrono::steady_clock::now();
+    for (QVector<Cell>& output : flow.outputs) {
+        for (Cell& cell : output) {
+            if (!cell.mask.empty()) {
+                cell.mask = cell.mask.clone();
+                ++oldClones;
+                oldBytes += static_cast<long long>(cell.mask.total() * cell.mask.elemSize());
+            }
+        }
+    }
+    const double cloneMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::printf("cell copies: %d cells, %lld Cell copies; clone on copy: %lld mask clones, %.1f MB, "
+                "%.1f ms; shared: 0 clones, %.1f ms\n",
+                static_cast<int>(cells.size()), flow.cellCopies, oldClones, oldBytes / 1048576.0,
+                sharedMs + cloneMs, sharedMs);
+
+    // Изменение пикселей отделяет буфер только у изменяемой копии
+    Cell copy = cells[0];
+    Cell::resetCopyStats();
+    copy.mutableMask().setTo(0);
+    check(copy.mask.data != cells[0].mask.data, "cell copies: mutableMask did not detach");
+    check(cv::countNonZero(cells[0].mask) > 0, "cell copies: mutableMask changed the original");
+    check(Cell::copyStats().pixelCopies == 1, "cell copies: detach not counted");
+    copy.mutableMask().setTo(255);
+    check(Cell::copyStats().pixelCopies == 1, "cell copies: owned buffer detached again");
+}
+
+} // namespace
+
+int main() {
+    testNmsMatchesBruteForce();
+    testDetectionsRoundTrip();
+    testCandidatesRoundTrip(false);
+    testCandidatesRoundTrip(true);
+    testCellCopiesSharePixels();
+
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,296 @@
+// tiling.cpp - Sliding-window tiling for high-resolution micrographs
+#include "tiling.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+std::vector<int> axisOrigins(int length, int tile, int stride) {
+    std::vector<int> origins;
+    if (length <= tile) {
+        origins.push_back(0);
+        return origins;
+    }
+    for (int pos = 0; ; pos += stride) {
+        if (pos + tile >= length) {
+            origins.push_back(length - tile);
+            break;
+        }
+        origins.push_back(pos);
+    }
+    return origins;
+}
+
+// IoU двух отрезков [a0, a1) и [b0, b1)
+float intervalIoU(int a0, int a1, int b0, int b1) {
+    int inter = std::min(a1, b1) - std::max(a0, b0);
+    if (inter <= 0) return 0.0f;
+    int uni = std::max(a1, b1) - std::min(a0, b0);
+    return uni > 0 ? static_cast<float>(inter) / uni : 0.0f;
+}
+
+// Фрагменты одной клетки по разные стороны вертикального шва (a слева, b справа)
+bool joinsAcrossVerticalSeam(const TileDetection& a, const TileDetection& b, int margin) {
+    if (!(a.seams & TileSeamRight) || !(b.seams & TileSeamLeft)) return false;
+    if (a.box.x >= b.box.x) return false;
+    if (a.box.x + a.box.width + margin < b.box.x) return false;
+    return intervalIoU(a.box.y, a.box.y + a.box.height, b.box.y, b.box.y + b.box.height) >= 0.6f;
+}
+
+// Фрагменты по разные стороны горизонтального шва (a сверху, b снизу)
+bool joinsAcrossHorizontalSeam(const TileDetection& a, const TileDetection& b, int margin) {
+    if (!(a.seams & TileSeamBottom) || !(b.seams & TileSeamTop)) return false;
+    if (a.box.y >= b.box.y) return false;
+    if (a.box.y + a.box.height + margin < b.box.y) return false;
+    return intervalIoU(a.box.x, a.box.x + a.box.width, b.box.x, b.box.x + b.box.width) >= 0.6f;
+}
+
+// Равномерная сетка над рамками, как в nonMaxSuppression: соседей ищем только
+// в ячейках, которые задевает запрос, поэтому шаги 2 и 3 слияния линейны по
+// числу детекций, а не квадратичны. Пустые рамки в сетку не попадают.
+class BoxGrid {
+public:
+    explicit BoxGrid(const std::vector<cv::Rect>& boxes)
+        : m_stamp(boxes.size(), -1)
+    {
+        std::vector<int> sizes;
+        bool first = true;
+        for (const cv::Rect& r : boxes) {
+            if (r.empty()) continue;
+            if (first) {
+                m_originX = r.x;
+                m_originY = r.y;
+                first = false;
+            }
+            m_originX = std::min(m_originX, r.x);
+            m_originY = std::min(m_originY, r.y);
+            m_extentX = std::max(m_extentX, r.x + r.width);
+            m_extentY = std::max(m_extentY, r.y + r.height);
+            sizes.push_back(std::max(r.width, r.height));
+        }
+        if (sizes.empty()) {
+            return;
+        }
+        m_extentX -= m_originX;
+        m_extentY -= m_originY;
+
+        // Ячейка ~ двух медианных рамок, не больше kMaxGridCells ячеек
+        std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2, sizes.end());
+        m_cellSize = std::max(1, 2 * sizes[sizes.size() / 2]);
+        while ((static_cast<long long>(m_extentX) / m_cellSize + 1) *
+               (static_cast<long long>(m_extentY) / m_cellSize + 1) > kMaxGridCells) {
+            m_cellSize *= 2;
+        }
+        m_width = m_extentX / m_cellSize + 1;
+        m_height = m_extentY / m_cellSize + 1;
+        m_cells.resize(static_cast<size_t>(m_width) * m_height);
+
+        for (int i = 0; i < static_cast<int>(boxes.size()); ++i) {
+            if (boxes[i].empty()) continue;
+            int gx0, gy0, gx1, gy1;
+            cellRange(boxes[i], gx0, gy0, gx1, gy1);
+            for (int gy = gy0; gy <= gy1; ++gy) {
+                for (int gx = gx0; gx <= gx1; ++gx) {
+                    m_cells[static_cast<size_t>(gy) * m_width + gx].push_back(i);
+                }
+            }
+        }
+    }
+
+    // Каждый индекс из ячеек query - один раз; visit возвращает true, чтобы остановиться
+    template <typename Visit>
+    void visitNear(const cv::Rect& query, Visit&& visit) {
+        if (m_cells.empty()) return;
+        ++m_query;
+        int gx0, gy0, gx1, gy1;
+        cellRange(query, gx0, gy0, gx1, gy1);
+        for (int gy = gy0; gy <= gy1; ++gy) {
+            for (int gx = gx0; gx <= gx1; ++gx) {
+                for (int j : m_cells[static_cast<size_t>(gy) * m_width + gx]) {
+                    if (m_stamp[j] == m_query) continue;
+                    m_stamp[j] = m_query;
+                    if (visit(j)) return;
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr long long kMaxGridCells = 1 << 20;
+
+    void cellRange(const cv::Rect& r, int& gx0, int& gy0, int& gx1, int& gy1) const {
+        gx0 = std::clamp((r.x - m_originX) / m_cellSize, 0, m_width - 1);
+        gy0 = std::clamp((r.y - m_originY) / m_cellSize, 0, m_height - 1);
+        gx1 = std::clamp((r.x - m_originX + std::max(0, r.width - 1)) / m_cellSize, 0, m_width - 1);
+        gy1 = std::clamp((r.y - m_originY + std::max(0, r.height - 1)) / m_cellSize, 0, m_height - 1);
+    }
+
+    int m_originX = 0, m_originY = 0;
+    int m_extentX = 0, m_extentY = 0;
+    int m_cellSize = 1;
+    int m_width = 0, m_height = 0;
+    std::vector<std::vector<int>> m_cells;
+    std::vector<int> m_stamp;
+    int m_query = 0;
+};
+
+int findRoot(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+} // namespace
+
+std::vector<cv::Rect> computeTileGrid(const cv::Size& imageSize, int tileSize, int overlap) {
+    std::vector<cv::Rect> tiles;
+    if (imageSize.width <= 0 || imageSize.height <= 0 || tileSize <= 0) {
+        return tiles;
+    }
+
+    overlap = std::max(0, std::min(overlap, tileSize - 1));
+    int stride = tileSize - overlap;
+
+    std::vector<int> xs = axisOrigins(imageSize.width, tileSize, stride);
+    std::vector<int> ys = axisOrigins(imageSize.height, tileSize, stride);
+    int tileWidth = std::min(tileSize, imageSize.width);
+    int tileHeight = std::min(tileSize, imageSize.height);
+
+    tiles.reserve(xs.size() * ys.size());
+    for (int y : ys) {
+        for (int x : xs) {
+            tiles.emplace_back(x, y, tileWidth, tileHeight);
+        }
+    }
+    return tiles;
+}
+
+unsigned tileSeamFlags(const cv::Rect& box, const cv::Rect& tile, const cv::Size& imageSize, int margin) {
+    unsigned seams = TileSeamNone;
+    if (tile.x > 0 && box.x <= tile.x + margin) {
+        seams |= TileSeamLeft;
+    }
+    if (tile.x + tile.width < imageSize.width && box.x + box.width >= tile.x + tile.width - margin) {
+        seams |= TileSeamRight;
+    }
+    if (tile.y > 0 && box.y <= tile.y + margin) {
+        seams |= TileSeamTop;
+    }
+    if (tile.y + tile.height < imageSize.height && box.y + box.height >= tile.y + tile.height - margin) {
+        seams |= TileSeamBottom;
+    }
+    return seams;
+}
+
+std::vector<TileDetection> mergeTileDetections(const std::vector<TileDetection>& detections,
+                                               const NmsOptions& nms) {
+    if (detections.empty()) {
+        return {};
+    }
+
+    // 1. Дубли из зон перекрытия, где оба тайла видели клетку целиком
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    std::vector<int> classIds;
+    boxes.reserve(detections.size());
+    scores.reserve(detections.size());
+    classIds.reserve(detections.size());
+    for (const TileDetection& det : detections) {
+        boxes.push_back(det.box);
+        scores.push_back(det.score);
+        classIds.push_back(det.classId);
+    }
+
+    std::vector<int> keep = nonMaxSuppression(boxes, scores, classIds, nms);
+
+    std::vector<TileDetection> kept;
+    kept.reserve(keep.size());
+    for (int idx : keep) {
+        kept.push_back(detections[idx]);
+    }
+
+    // 2. Обрезанный швом фрагмент внутри рамки соседнего тайла - это та же клетка.
+    // Такая рамка пересекает фрагмент, значит лежит в общих с ним ячейках сетки
+    std::vector<cv::Rect> keptBoxes;
+    keptBoxes.reserve(kept.size());
+    for (const TileDetection& det : kept) {
+        keptBoxes.push_back(det.box);
+    }
+    BoxGrid keptGrid(keptBoxes);
+
+    std::vector<bool> dropped(kept.size(), false);
+    for (size_t i = 0; i < kept.size(); ++i) {
+        if (kept[i].seams == TileSeamNone) continue;
+        const cv::Rect& a = kept[i].box;
+        keptGrid.visitNear(a, [&](int j) {
+            if (static_cast<size_t>(j) == i || dropped[j] || kept[j].tileIndex == kept[i].tileIndex) return false;
+            const cv::Rect& b = kept[j].box;
+            if (b.area() <= a.area()) return false;
+            if ((a & b).area() >= 0.85 * a.area()) {
+                dropped[i] = true;
+                return true;
+            }
+            return false;
+        });
+    }
+
+    std::vector<TileDetection> candidates;
+    for (size_t i = 0; i < kept.size(); ++i) {
+        if (!dropped[i]) candidates.push_back(kept[i]);
+    }
+
+    // 3. Клетка крупнее перекрытия: склеиваем фрагменты по разные стороны шва.
+    // Пара фрагментов соприкасается с точностью до margin, поэтому ищем только
+    // среди фрагментов у шва в ячейках рамки, расширенной на margin
+    const int margin = 2;
+    std::vector<int> parent(candidates.size());
+    std::iota(parent.begin(), parent.end(), 0);
+
+    std::vector<cv::Rect> seamBoxes(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates[i].seams != TileSeamNone) {
+            seamBoxes[i] = candidates[i].box;
+        }
+    }
+    BoxGrid seamGrid(seamBoxes);
+
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates[i].seams == TileSeamNone) continue;
+        cv::Rect query(candidates[i].box.x - margin - 1, candidates[i].box.y - margin - 1,
+                       candidates[i].box.width + 2 * margin + 2, candidates[i].box.height + 2 * margin + 2);
+        seamGrid.visitNear(query, [&](int j) {
+            if (static_cast<size_t>(j) == i) return false;
+            if (candidates[i].tileIndex == candidates[j].tileIndex) return false;
+            if (joinsAcrossVerticalSeam(candidates[i], candidates[j], margin) ||
+                joinsAcrossHorizontalSeam(candidates[i], candidates[j], margin)) {
+                int ri = findRoot(parent, static_cast<int>(i));
+                int rj = findRoot(parent, j);
+                if (ri != rj) parent[rj] = ri;
+            }
+            return false;
+        });
+    }
+
+    std::vector<TileDetection> merged;
+    std::vector<int> groupSlot(candidates.size(), -1);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        int root = findRoot(parent, static_cast<int>(i));
+        if (groupSlot[root] < 0) {
+            groupSlot[root] = static_cast<int>(merged.size());
+            merged.push_back(candidates[i]);
+            continue;
+        }
+        TileDetection& group = merged[groupSlot[root]];
+        group.box |= candidates[i].box;
+        group.seams |= candidates[i].seams;
+        if (candidates[i].score > group.score) {
+            group.score = candidates[i].score;
+            group.classId = candidates[i].classId;
+            group.tileIndex = candidates[i].tileIndex;
+        }
+    }
+
+    return merged;
+}
@@ -0,0 +1,42 @@
+// tiling.h - Sliding-window tiling for high-resolution micrographs
+#ifndef TILING_H
+#define TILING_H
+
+#include "nms.h"
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Флаги внутренних швов тайла, которых касается рамка детекции.
+// Края самого изображения швами не считаются.
+enum TileSeam : unsigned {
+    TileSeamNone   = 0,
+    TileSeamLeft   = 1u << 0,
+    TileSeamRight  = 1u << 1,
+    TileSeamTop    = 1u << 2,
+    TileSeamBottom = 1u << 3
+};
+
+struct TileDetection {
+    cv::Rect box;           // в координатах исходного изображения
+    float score = 0.0f;
+    int classId = 0;
+    int tileIndex = -1;
+    unsigned seams = TileSeamNone;
+};
+
+// Сетка перекрывающихся тайлов tileSize x tileSize с шагом tileSize - overlap.
+// Последний тайл в ряду/столбце прижимается к краю, чтобы не выходить за изображение.
+std::vector<cv::Rect> computeTileGrid(const cv::Size& imageSize, int tileSize, int overlap);
+
+// Какие внутренние швы тайла задевает рамка (рамка в глобальных координатах)
+unsigned tileSeamFlags(const cv::Rect& box, const cv::Rect& tile, const cv::Size& imageSize,
+                       int margin = 2);
+
+// Объединение детекций со всех тайлов в координатах исходного изображения:
+// 1) NMS (с учетом классов, см. NmsOptions) убирает дубли из зон перекрытия;
+// 2) фрагменты, обрезанные швом и целиком лежащие внутри рамки соседнего тайла, удаляются;
+// 3) фрагменты одной клетки по разные стороны шва (клетка больше перекрытия) склеиваются.
+std::vector<TileDetection> mergeTileDetections(const std::vector<TileDetection>& detections,
+                                               const NmsOptions& nms);
+
+#endif // TILING_H
@@ -1,4 +1,8 @@
 #include "utils.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <map>
 
 QImage matToQImage(const cv::Mat& mat) {
     if (mat.empty()) {
@@ -63,3 +67,54 @@ double visibleCircleRatio(int x, int y, int r, int width, int height) {
 
     return visibleRectArea / circleArea;
 }
+
+namespace {
+
+QMutex cvThreadsMutex;
+int cvThreadsScopes = 0;
+int cvThreadsSaved = 0;
+std::map<int, int> cvThreadsRequests;  // запрошенное число потоков -> число областей
+
+// Под cvThreadsMutex
+void applyCvThreads() {
+    cv::setNumThreads(cvThreadsRequests.empty() ? cvThreadsSaved : cvThreadsRequests.begin()->first);
+}
+
+} // namespace
+
+CvThreadsScope::CvThreadsScope(int threads) {
+    QMutexLocker locker(&cvThreadsMutex);
+    if (cvThreadsScopes++ == 0) {
+        cvThreadsSaved = cv::getNumThreads();
+    }
+    m_threads = std::max(0, threads);
+    if (m_threads > 0) {
+        ++cvThreadsRequests[m_threads];
+        applyCvThreads();
+    }
+}
+
+CvThreadsScope::~CvThreadsScope() {
+    QMutexLocker locker(&cvThreadsMutex);
+    if (m_threads > 0 && --cvThreadsRequests[m_threads] == 0) {
+        cvThreadsRequests.erase(m_threads);
+    }
+    if (--cvThreadsScopes == 0) {
+        cvThreadsRequests.clear();
+        cv::setNumThreads(cvThreadsSaved);
+    } else {
+        applyCvThreads();
+    }
+}
+
+void CvThreadsScope::set(int threads) {
+    QMutexLocker locker(&cvThreadsMutex);
+    if (m_threads > 0 && --cvThreadsRequests[m_threads] == 0) {
+        cvThreadsRequests.erase(m_threads);
+    }
+    m_threads = std::max(0, threads);
+    if (m_threads > 0) {
+        ++cvThreadsRequests[m_threads];
+    }
+    applyCvThreads();
+}
@@ -8,4 +8,22 @@ QImage matToQImage(const cv::Mat& mat);
 bool isCircleInsideImage(int x, int y, int r, int width, int height);
 double visibleCircleRatio(int x, int y, int r, int width, int height);
 
+// cv::setNumThreads глобален для процесса, а прогоны могут идти одновременно
+// (анализ в GUI и порция наблюдения за папкой). Вместо сохранения/восстановления
+// в каждом прогоне - общий счетчик: первая область запоминает прежнее значение,
+// последняя его восстанавливает, пока открыты несколько - действует наименьшее
+// из запрошенных (0 = не менять).
+class CvThreadsScope {
+public:
+    explicit CvThreadsScope(int threads = 0);
+    ~CvThreadsScope();
+    void set(int threads);
+
+private:
+    CvThreadsScope(const CvThreadsScope&) = delete;
+    CvThreadsScope& operator=(const CvThreadsScope&) = delete;
+
+    int m_threads = 0;
+};
+
 #endif // UTILS_H
@@ -11,10 +11,33 @@
 #include <QSettings>
 #include <QImage>
 #include <QScrollBar>
+#include <QSignalBlocker>
 #include <cmath>
+#include <algorithm>
 #include "logger.h"
 #include "settingsmanager.h"
+#include "cellexporter.h"
 #include "utils.h"
+#include "imagecatalog.h"
+
+namespace {
+
+// Клетка после пересчета порогов считается удаленной вручную, если ее рамка
+// почти совпадает с рамкой удаленной: при другом IoU NMS может оставить
+// соседнюю рамку того же объекта
+bool matchesRemovedBox(const cv::Rect& box, const QVector<cv::Rect>& removed)
+{
+    for (const cv::Rect& other : removed) {
+        int intersection = (box & other).area();
+        int unionArea = box.area() + other.area() - intersection;
+        if (unionArea > 0 && intersection >= 0.5 * unionArea) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
 
 VerificationWidget::VerificationWidget(const QVector<Cell>& cells, QWidget *parent)
     : QWidget(parent)
@@ -29,6 +52,11 @@ VerificationWidget::VerificationWidget(const QVector<Cell>& cells, QWidget *pare
     , m_cellPositionLabel(nullptr)
     , m_cellRadiusLabel(nullptr)
     , m_cellAreaLabel(nullptr)
+    , m_thresholdPanel(nullptr)
+    , m_confSlider(nullptr)
+    , m_iouSlider(nullptr)
+    , m_confValueLabel(nullptr)
+    , m_iouValueLabel(nullptr)
     , m_coefficientEdit(nullptr)
     , m_editCoefficientButton(nullptr)
     , m_recalcButton(nullptr)
@@ -36,8 +64,12 @@ VerificationWidget::VerificationWidget(const QVector<Cell>& cells, QWidget *pare
     , m_statisticsButton(nullptr)
     , m_saveButton(nullptr)
     , m_finishButton(nullptr)
+    , m_analysisStatusLabel(nullptr)
+    , m_stopAnalysisButton(nullptr)
     , m_cells(cells)
     , m_selectedCellIndex(-1)
+    , m_thresholdProcessor(nullptr)
+    , m_thresholdTimer(nullptr)
     , m_thumbnailLoadTimer(nullptr)
     , m_thumbnailLoadIndex(0)
 {
@@ -76,15 +108,36 @@ VerificationWidget::~VerificationWidget()
         m_thumbnailLoadTimer->deleteLater();
         m_thumbnailLoadTimer = nullptr;
     }
+
+    delete m_thresholdProcessor;
 }
 
 void VerificationWidget::groupCellsByFile()
 {
     m_cellsByFile.clear();
 
-    for (int i = 0; i < m_cells.size(); ++i) {
-        QString imagePath = QString::fromStdString(m_cells[i].imagePath);
-        m_cellsByFile[imagePath].append(i);
+    // Вкладки сохраняют порядок поступления файлов, даже если в файле
+    // не осталось клеток после удаления
+    for (const QString& filePath : m_filePaths) {
+        m_cellsByFile.insert(filePath, QVector<int>());
+    }
+
+    // Подсчетом по id изображения: путь строится один раз на файл, а не на клетку
+    std::vector<int> imageIds;
+    imageIds.reserve(m_cells.size());
+    for (const Cell& cell : m_cells) {
+        imageIds.push_back(cell.imageId);
+    }
+    const ImageCatalog::Grouping grouping = ImageCatalog::groupByImage(imageIds);
+    for (int id = 0; id < grouping.idCount(); ++id) {
+        if (grouping.count(id) == 0) {
+            continue;
+        }
+        QString imagePath = ImageCatalog::instance().path(id);
+        if (!m_cellsByFile.contains(imagePath)) {
+            m_filePaths.append(imagePath);
+        }
+        m_cellsByFile[imagePath] = QVector<int>(grouping.begin(id), grouping.end(id));
     }
 
     LOG_INFO(QString("Cells grouped into %1 files").arg(m_cellsByFile.size()));
@@ -106,16 +159,8 @@ void VerificationWidget::setupUI()
     m_fileTabWidget->blockSignals(true);
 
     // Create tabs for each file
-    int tabIndex = 0;
-    for (auto it = m_cellsByFile.begin(); it != m_cellsByFile.end(); ++it) {
-        QString filePath = it.key();
-        QVector<int> cellIndices = it.value();
-
-        QString fileName = QFileInfo(filePath).fileName();
-        QString tabLabel = QString("%1 (%2)").arg(fileName).arg(cellIndices.size());
-        m_fileTabWidget->addTab(new QWidget(), tabLabel);
-        m_fileTabWidget->setTabToolTip(tabIndex++, filePath);
-        LOG_INFO(QString("setupUI: Added tab for %1 with %2 cells").arg(fileName).arg(cellIndices.size()));
+    for (const QString& filePath : m_filePaths) {
+        addFileTab(filePath);
     }
 
     // Unblock signals AFTER all UI is created
@@ -209,6 +254,54 @@ void VerificationWidget::setupUI()
     zoomToolbar->setLayout(zoomLayout);
     rightLayout->addWidget(zoomToolbar);
 
+    // Пороги детекции для текущего изображения: пересчет по сохраненным
+    // кандидатам, без повторного инференса. Видны после завершения анализа.
+    m_thresholdPanel = new QWidget(this);
+    m_thresholdPanel->setMaximumHeight(50);
+    QHBoxLayout* thresholdLayout = new QHBoxLayout(m_thresholdPanel);
+    thresholdLayout->setContentsMargins(5, 5, 5, 5);
+    thresholdLayout->setSpacing(5);
+
+    thresholdLayout->addWidget(new QLabel("Уверенность:"));
+    m_confSlider = new QSlider(Qt::Horizontal);
+    m_confSlider->setRange(5, 95);
+    m_confSlider->setToolTip("Порог уверенности детекции для этого изображения");
+    connect(m_confSlider, &QSlider::valueChanged, this, &VerificationWidget::onThresholdSliderChanged);
+    thresholdLayout->addWidget(m_confSlider, 1);
+    m_confValueLabel = new QLabel();
+    m_confValueLabel->setMinimumWidth(40);
+    thresholdLayout->addWidget(m_confValueLabel);
+
+    thresholdLayout->addWidget(new QLabel("IoU:"));
+    m_iouSlider = new QSlider(Qt::Horizontal);
+    m_iouSlider->setRange(10, 95);
+    m_iouSlider->setToolTip("Порог перекрытия NMS: меньше - сильнее подавляются соседние рамки");
+    connect(m_iouSlider, &QSlider::valueChanged, this, &VerificationWidget::onThresholdSliderChanged);
+    thresholdLayout->addWidget(m_iouSlider, 1);
+    m_iouValueLabel = new QLabel();
+    m_iouValueLabel->setMinimumWidth(40);
+    thresholdLayout->addWidget(m_iouValueLabel);
+
+    QPushButton* resetThresholdsBtn = new QPushButton("Сбросить");
+    resetThresholdsBtn->setToolTip("Вернуть пороги анализа");
+    connect(resetThresholdsBtn, &QPushButton::clicked, this, [this]() {
+        QSignalBlocker blockConf(m_confSlider);
+        QSignalBlocker blockIou(m_iouSlider);
+        m_confSlider->setValue(qRound(m_thresholdParams.confThreshold * 100));
+        m_iouSlider->setValue(qRound(m_thresholdParams.iouThreshold * 100));
+        onThresholdSliderChanged();
+    });
+    thresholdLayout->addWidget(resetThresholdsBtn);
+
+    m_thresholdPanel->setLayout(thresholdLayout);
+    m_thresholdPanel->hide();
+    rightLayout->addWidget(m_thresholdPanel);
+
+    m_thresholdTimer = new QTimer(this);
+    m_thresholdTimer->setSingleShot(true);
+    m_thresholdTimer->setInterval(0);
+    connect(m_thresholdTimer, &QTimer::timeout, this, &VerificationWidget::applyThresholds);
+
     // Cell info panel
     m_infoPanel = new QWidget(this);
     m_infoPanel->setMaximumHeight(100);
@@ -292,6 +385,22 @@ void VerificationWidget::setupUI()
 
     bottomLayout->addStretch();
 
+    // Состояние потокового анализа: видно, пока приходят результаты
+    m_analysisStatusLabel = new QLabel(this);
+    m_analysisStatusLabel->setStyleSheet("QLabel { color: #FFA000; font-weight: bold; }");
+    m_analysisStatusLabel->hide();
+    bottomLayout->addWidget(m_analysisStatusLabel);
+
+    m_stopAnalysisButton = new QPushButton("Остановить анализ");
+    m_stopAnalysisButton->setStyleSheet("QPushButton { border: 1px solid #f44336; color: #f44336; border-radius: 5px; padding: 5px 15px; }");
+    m_stopAnalysisButton->hide();
+    connect(m_stopAnalysisButton, &QPushButton::clicked, this, [this]() {
+        m_stopAnalysisButton->setEnabled(false);
+        m_analysisStatusLabel->setText("Остановка анализа...");
+        emit analysisCancelRequested();
+    });
+    bottomLayout->addWidget(m_stopAnalysisButton);
+
     // Statistics button
     m_statisticsButton = new QPushButton("📊 Статистика");
     m_statisticsButton->setStyleSheet("QPushButton { background-color: #9C27B0; color: white; border-radius: 10px; padding: 8px 16px; font-weight: bold; }");
@@ -329,9 +438,232 @@ void VerificationWidget::setupUI()
     LOG_INFO("VerificationWidget UI setup completed");
 }
 
+void VerificationWidget::addFileTab(const QString& filePath)
+{
+    QString fileName = QFileInfo(filePath).fileName();
+    int count = m_cellsByFile.value(filePath).size();
+    int tabIndex = m_fileTabWidget->addTab(new QWidget(), QString("%1 (%2)").arg(fileName).arg(count));
+    m_fileTabWidget->setTabToolTip(tabIndex, filePath);
+    LOG_INFO(QString("Added tab for %1 with %2 cells").arg(fileName).arg(count));
+}
+
+void VerificationWidget::updateFileTabLabel(int tabIndex)
+{
+    if (tabIndex < 0 || tabIndex >= m_filePaths.size()) return;
+
+    const QString& filePath = m_filePaths[tabIndex];
+    QString fileName = QFileInfo(filePath).fileName();
+    int count = m_cellsByFile.value(filePath).size();
+    m_fileTabWidget->setTabText(tabIndex, QString("%1 (%2)").arg(fileName).arg(count));
+}
+
+void VerificationWidget::addImageResults(const QString& imagePath, const QVector<Cell>& cells)
+{
+    // Клетки дописываются в конец: глобальные индексы уже открытых файлов не меняются
+    int tabIndex = m_filePaths.indexOf(imagePath);
+    bool newFile = tabIndex < 0;
+    if (!newFile && cells.isEmpty()) return;
+    if (newFile) {
+        m_filePaths.append(imagePath);
+        m_cellsByFile.insert(imagePath, QVector<int>());
+        tabIndex = m_filePaths.size() - 1;
+    }
+
+    QVector<int>& indices = m_cellsByFile[imagePath];
+    for (const Cell& cell : cells) {
+        indices.append(m_cells.size());
+        m_cells.append(cell);
+    }
+
+    LOG_INFO(QString("Streamed %1 cells for %2").arg(cells.size()).arg(QFileInfo(imagePath).fileName()));
+
+    if (newFile) {
+        // Первая вкладка становится текущей и сама вызывает onFileTabChanged
+        addFileTab(imagePath);
+    } else {
+        updateFileTabLabel(tabIndex);
+        if (imagePath == m_currentFilePath) {
+            updateCellList();
+            updatePreviewImage();
+        }
+    }
+}
+
+void VerificationWidget::setAnalysisProgress(int processed, int total)
+{
+    m_analysisStatusLabel->setText(QString("Анализ: %1 из %2 изображений").arg(processed).arg(total));
+    if (m_analysisStatusLabel->isHidden()) {
+        m_analysisStatusLabel->show();
+        m_stopAnalysisButton->setEnabled(true);
+        m_stopAnalysisButton->show();
+
+        // Экспорт, статистика и завершение - по полному набору результатов
+        m_statisticsButton->setEnabled(false);
+        m_saveButton->setEnabled(false);
+        m_finishButton->setEnabled(false);
+    }
+}
+
+void VerificationWidget::finishAnalysis()
+{
+    m_analysisStatusLabel->hide();
+    m_stopAnalysisButton->hide();
+    m_statisticsButton->setEnabled(true);
+    m_saveButton->setEnabled(true);
+    m_finishButton->setEnabled(true);
+}
+
+void VerificationWidget::setThresholdSource(ImageProcessor* processor, const ImageProcessor::YoloParams& params)
+{
+    if (processor == m_thresholdProcessor) return;
+
+    delete m_thresholdProcessor;
+    m_thresholdProcessor = processor;
+    m_thresholdParams = params;
+    m_thresholdsByFile.clear();
+    if (m_thresholdProcessor) {
+        // Колбэки анализа смотрят в MainWindow; результаты пересчета забираем сами
+        m_thresholdProcessor->setResultCallback(nullptr);
+        m_thresholdProcessor->setProgressCallback(nullptr);
+    }
+
+    // Ниже пола кандидаты не сохранены
+    const double floor = std::min(params.confThreshold, params.candidateFloor);
+    m_confSlider->setMinimum(std::max(1, static_cast<int>(std::ceil(floor * 100 - 1e-6))));
+    updateThresholdPanel();
+}
+
+void VerificationWidget::updateThresholdPanel()
+{
+    if (!m_thresholdPanel) return;
+
+    m_thresholdPanel->setVisible(m_thresholdProcessor != nullptr);
+    if (!m_thresholdProcessor) return;
+
+    // Изображения, не дошедшие до конца при отмене анализа, кандидатов не имеют
+    m_thresholdPanel->setEnabled(m_thresholdProcessor->hasRetainedCandidates(m_currentFilePath));
+
+    ImageThresholds thresholds = m_thresholdsByFile.value(
+        m_currentFilePath, ImageThresholds{m_thresholdParams.confThreshold, m_thresholdParams.iouThreshold});
+    QSignalBlocker blockConf(m_confSlider);
+    QSignalBlocker blockIou(m_iouSlider);
+    m_confSlider->setValue(qRound(thresholds.conf * 100));
+    m_iouSlider->setValue(qRound(thresholds.iou * 100));
+    updateThresholdLabels();
+}
+
+void VerificationWidget::updateThresholdLabels()
+{
+    m_confValueLabel->setText(QString::number(m_confSlider->value() / 100.0, 'f', 2));
+    m_iouValueLabel->setText(QString::number(m_iouSlider->value() / 100.0, 'f', 2));
+}
+
+void VerificationWidget::onThresholdSliderChanged()
+{
+    updateThresholdLabels();
+
+    // Пачка valueChanged при перетаскивании -> один пересчет
+    if (!m_thresholdTimer->isActive()) {
+        m_thresholdTimer->start();
+    }
+}
+
+void VerificationWidget::applyThresholds()
+{
+    if (!m_thresholdProcessor || m_currentFilePath.isEmpty()) return;
+
+    const QString filePath = m_currentFilePath;
+    ImageThresholds thresholds{m_confSlider->value() / 100.0, m_iouSlider->value() / 100.0};
+    m_thresholdsByFile[filePath] = thresholds;
+
+    ImageProcessor::YoloParams params = m_thresholdParams;
+    params.confThreshold = std::max(thresholds.conf, std::min(params.confThreshold, params.candidateFloor));
+    params.iouThreshold = thresholds.iou;
+    if (!m_thresholdProcessor->rethreshold(params, QStringList{filePath})) {
+        LOG_WARNING(QString("Threshold change failed: %1").arg(m_thresholdProcessor->getLastError()));
+        return;
+    }
+
+    // Удаленные вручную клетки не возвращаются при любых порогах
+    const QVector<cv::Rect> removed = m_removedByFile.value(filePath);
+    const QVector<Cell> detected = m_thresholdProcessor->getDetectedCells();
+    QVector<Cell> cells;
+    for (const Cell& cell : detected) {
+        cv::Rect box(cell.bbox_x, cell.bbox_y, cell.bbox_width, cell.bbox_height);
+        if (!matchesRemovedBox(box, removed)) {
+            cells.append(cell);
+        }
+    }
+
+    LOG_INFO(QString("Thresholds for %1: conf %2, iou %3 -> %4 cells")
+        .arg(QFileInfo(filePath).fileName()).arg(thresholds.conf).arg(thresholds.iou).arg(cells.size()));
+    replaceFileCells(filePath, cells);
+}
+
+void VerificationWidget::rememberRemovedCell(int globalCellIndex)
+{
+    if (globalCellIndex < 0 || globalCellIndex >= m_cells.size()) return;
+
+    const Cell& cell = m_cells[globalCellIndex];
+    m_removedByFile[ImageCatalog::instance().path(cell.imageId)].append(
+        cv::Rect(cell.bbox_x, cell.bbox_y, cell.bbox_width, cell.bbox_height));
+}
+
+void VerificationWidget::replaceFileCells(const QString& filePath, const QVector<Cell>& cells)
+{
+    // Клетки файла встают на место прежних, порядок остальных файлов не меняется.
+    // После потокового добавления и прошлых замен клетки файла идут подряд.
+    const QVector<int> indices = m_cellsByFile.value(filePath);
+    const bool contiguous = indices.isEmpty() || indices.last() - indices.first() + 1 == indices.size();
+    if (contiguous) {
+        const int first = indices.isEmpty() ? m_cells.size() : indices.first();
+        const int oldCount = indices.size();
+        const int newCount = cells.size();
+        if (newCount > oldCount) {
+            m_cells.insert(first + oldCount, newCount - oldCount, Cell());
+        } else if (newCount < oldCount) {
+            m_cells.remove(first + newCount, oldCount - newCount);
+        }
+        for (int i = 0; i < newCount; ++i) {
+            m_cells[first + i] = cells[i];
+        }
+    } else {
+        const int imageId = ImageCatalog::instance().find(filePath);
+        QVector<Cell> updated;
+        updated.reserve(m_cells.size() - indices.size() + cells.size());
+        bool inserted = false;
+        for (const Cell& cell : m_cells) {
+            if (cell.imageId != imageId) {
+                updated.append(cell);
+            } else if (!inserted) {
+                updated += cells;
+                inserted = true;
+            }
+        }
+        m_cells = updated;
+    }
+
+    groupCellsByFile();
+    updateFileTabLabel(m_filePaths.indexOf(filePath));
+
+    if (filePath != m_currentFilePath) return;
+
+    updateCellList();
+    updatePreviewCells();
+
+    const QVector<int> cellIndices = m_cellsByFile.value(filePath);
+    if (!cellIndices.isEmpty()) {
+        selectCell(cellIndices.first());
+    } else {
+        m_selectedCellIndex = -1;
+        m_previewWidget->setSelectedCell(-1);
+        updateCellInfoPanel();
+    }
+}
+
 void VerificationWidget::onFileTabChanged(int index)
 {
-    if (index < 0 || index >= m_cellsByFile.size()) return;
+    if (index < 0 || index >= m_filePaths.size()) return;
 
     // Останавливаем предыдущий таймер загрузки
     if (m_thumbnailLoadTimer && m_thumbnailLoadTimer->isActive()) {
@@ -339,13 +671,13 @@ void VerificationWidget::onFileTabChanged(int index)
     }
 
     // Get file path for this tab
-    QStringList filePaths = m_cellsByFile.keys();
-    m_currentFilePath = filePaths[index];
+    m_currentFilePath = m_filePaths[index];
 
     LOG_INFO(QString("File tab changed to: %1").arg(m_currentFilePath));
 
     updateCellList();
     updatePreviewImage();
+    updateThresholdPanel();
 
     // Select first cell in this file
     QVector<int> cellIndices = m_cellsByFile[m_currentFilePath];
@@ -416,6 +748,14 @@ void VerificationWidget::updatePreviewImage()
 
     // Load and display image with all cells
     m_previewWidget->setImage(m_currentFilePath);
+    updatePreviewCells();
+}
+
+void VerificationWidget::updatePreviewCells()
+{
+    if (!m_cellsByFile.contains(m_currentFilePath)) {
+        return;
+    }
 
     // Get cells for current file
     QVector<int> cellIndices = m_cellsByFile[m_currentFilePath];
@@ -542,6 +882,7 @@ void VerificationWidget::onImageCellRightClicked(int localCellIndex)
         int globalIndex = cellIndices[localCellIndex];
 
         // Remove cell from data
+        rememberRemovedCell(globalIndex);
         m_cells.removeAt(globalIndex);
 
         // Regroup cells
@@ -549,13 +890,7 @@ void VerificationWidget::onImageCellRightClicked(int localCellIndex)
 
         // Update current tab label
         int currentTabIndex = m_fileTabWidget->currentIndex();
-        QStringList filePaths = m_cellsByFile.keys();
-        if (currentTabIndex < filePaths.size()) {
-            QString filePath = filePaths[currentTabIndex];
-            QString fileName = QFileInfo(filePath).fileName();
-            int count = m_cellsByFile[filePath].size();
-            m_fileTabWidget->setTabText(currentTabIndex, QString("%1 (%2)").arg(fileName).arg(count));
-        }
+        updateFileTabLabel(currentTabIndex);
 
         // Refresh UI
         updateCellList();
@@ -592,6 +927,7 @@ void VerificationWidget::onCellItemRemoved(CellListItemWidget* item)
         }
 
         // Remove cell from data
+        rememberRemovedCell(globalIndex);
         m_cells.removeAt(globalIndex);
 
         // Regroup cells
@@ -599,13 +935,7 @@ void VerificationWidget::onCellItemRemoved(CellListItemWidget* item)
 
         // Update current tab label
         int currentTabIndex = m_fileTabWidget->currentIndex();
-        QStringList filePaths = m_cellsByFile.keys();
-        if (currentTabIndex < filePaths.size()) {
-            QString filePath = filePaths[currentTabIndex];
-            QString fileName = QFileInfo(filePath).fileName();
-            int count = m_cellsByFile[filePath].size();
-            m_fileTabWidget->setTabText(currentTabIndex, QString("%1 (%2)").arg(fileName).arg(count));
-        }
+        updateFileTabLabel(currentTabIndex);
 
         // Refresh UI
         updateCellList();
@@ -811,49 +1141,30 @@ void VerificationWidget::onSaveCellsClicked()
     QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss");
     QString csvPath = resultsDir + QString("/cell_analysis_%1.csv").arg(timestamp);
 
-    QFile csvFile(csvPath);
-    if (csvFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream stream(&csvFile);
-        stream << "filename,cell_number,center_x,center_y,diameter_pixels,diameter_um\n";
-
-        QSet<QString> processedImages;
-        int cellNumber = 1;
+    try {
+        CellExporter::writeFile(csvPath, verifiedCells, CellExporter::Format::Csv);
+        LOG_INFO(QString("CSV exported to: %1").arg(csvPath));
 
+        std::vector<int> imageIds;
+        imageIds.reserve(verifiedCells.size());
         for (const auto& cellPair : verifiedCells) {
-            const Cell& cell = cellPair.first;
-            double diameterNm = cellPair.second;
-
-            QString imagePath = QString::fromStdString(cell.imagePath);
-            QString filename = QFileInfo(imagePath).fileName();
-
-            cv::Vec3f circle = cell.circle;
-            int centerX = cvRound(circle[0]);
-            int centerY = cvRound(circle[1]);
-
-            stream << QString("%1,%2,%3,%4,%5,%6\n")
-                .arg(filename)
-                .arg(cellNumber++)
-                .arg(centerX)
-                .arg(centerY)
-                .arg(cell.diameterPx)
-                .arg(diameterNm, 0, 'f', 2);
-
-            processedImages.insert(imagePath);
+            imageIds.push_back(cellPair.first.imageId);
         }
 
-        csvFile.close();
-        LOG_INFO(QString("CSV exported to: %1").arg(csvPath));
-
         // Save debug images with highlighted cells
-        for (const QString& imagePath : processedImages) {
+        const ImageCatalog::Grouping grouping = ImageCatalog::groupByImage(imageIds);
+        for (int id = 0; id < grouping.idCount(); ++id) {
+            if (grouping.count(id) == 0) {
+                continue;
+            }
             QVector<QPair<Cell, double>> imageCells;
-            for (const auto& cellPair : verifiedCells) {
-                if (QString::fromStdString(cellPair.first.imagePath) == imagePath) {
-                    imageCells.append(cellPair);
-                }
+            imageCells.reserve(grouping.count(id));
+            for (const int* index = grouping.begin(id); index != grouping.end(id); ++index) {
+                imageCells.append(verifiedCells[*index]);
             }
 
-            QString debugFileName = QFileInfo(imagePath).baseName() + "_highlighted.png";
+            QString imagePath = ImageCatalog::instance().path(id);
+            QString debugFileName = ImageCatalog::instance().baseName(id) + "_highlighted.png";
             QString debugPath = resultsDir + "/" + debugFileName;
             saveDebugImage(imagePath, imageCells, debugPath);
         }
@@ -867,9 +1178,9 @@ void VerificationWidget::onSaveCellsClicked()
             QString("Результаты сохранены:\n- CSV: %1\n- Папка с результатами: %2")
             .arg(QFileInfo(csvPath).fileName())
             .arg(resultsDir));
-    } else {
+    } catch (const std::exception& e) {
         QMessageBox::critical(this, "Ошибка", "Не удалось создать файл CSV.");
-        LOG_ERROR(QString("Failed to create CSV file: %1").arg(csvPath));
+        LOG_ERROR(QString("Failed to create CSV file: %1").arg(e.what()));
     }
 }
 
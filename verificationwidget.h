@@ -12,7 +12,9 @@
 #include <QVBoxLayout>
 #include <QMap>
 #include <QTimer>
+#include <QSlider>
 #include "cell.h"
+#include "imageprocessor.h"
 #include "celllistitemwidget.h"
 #include "markupimagewidget.h"
 
@@ -20,14 +22,27 @@ class VerificationWidget : public QWidget {
     Q_OBJECT
 
 public:
-    explicit VerificationWidget(const QVector<Cell>& cells, QWidget *parent = nullptr);
+    explicit VerificationWidget(const QVector<Cell>& cells = QVector<Cell>(), QWidget *parent = nullptr);
     ~VerificationWidget();
 
     QVector<Cell> getVerifiedCells() const;
 
+    // Источник кандидатов для ползунков порогов: processor завершил processImages
+    // с retainCandidates, виджет становится его владельцем. params - параметры анализа.
+    void setThresholdSource(ImageProcessor* processor, const ImageProcessor::YoloParams& params);
+
+public slots:
+    // Потоковый режим: результаты изображения добавляются по мере готовности,
+    // новая вкладка файла появляется, пока остальные изображения еще в обработке.
+    // Пустой cells тоже создает вкладку - для подбора порогов ползунками
+    void addImageResults(const QString& imagePath, const QVector<Cell>& cells);
+    void setAnalysisProgress(int processed, int total);
+    void finishAnalysis();
+
 signals:
     void analysisCompleted();
     void statisticsRequested();
+    void analysisCancelRequested();
 
 private slots:
     void onFileTabChanged(int index);
@@ -42,15 +57,24 @@ private slots:
     void loadNextThumbnailBatch();
     void onEditCoefficientClicked();
     void onCoefficientEditingFinished();
+    void onThresholdSliderChanged();
+    void applyThresholds();
 
 private:
     // Setup methods
     void setupUI();
     void groupCellsByFile();
     void createFileTab(const QString& filePath, const QVector<int>& cellIndices);
+    void addFileTab(const QString& filePath);
+    void updateFileTabLabel(int tabIndex);
     void updateCellInfoPanel();
     void updateCellList();
     void updatePreviewImage();
+    void updatePreviewCells();
+    void updateThresholdPanel();
+    void updateThresholdLabels();
+    void rememberRemovedCell(int globalCellIndex);
+    void replaceFileCells(const QString& filePath, const QVector<Cell>& cells);
 
     // Helper methods
     void selectCell(int globalCellIndex);
@@ -79,6 +103,13 @@ private:
     QLabel* m_cellRadiusLabel;
     QLabel* m_cellAreaLabel;
 
+    // Per-image thresholds over the retained candidates
+    QWidget* m_thresholdPanel;
+    QSlider* m_confSlider;
+    QSlider* m_iouSlider;
+    QLabel* m_confValueLabel;
+    QLabel* m_iouValueLabel;
+
     // Bottom toolbar
     QLineEdit* m_coefficientEdit;
     QPushButton* m_editCoefficientButton;
@@ -87,14 +118,28 @@ private:
     QPushButton* m_statisticsButton;
     QPushButton* m_saveButton;
     QPushButton* m_finishButton;
+    QLabel* m_analysisStatusLabel;
+    QPushButton* m_stopAnalysisButton;
 
     // Data
     QVector<Cell> m_cells;
     QMap<QString, QVector<int>> m_cellsByFile; // filepath -> cell indices
+    QStringList m_filePaths;                   // file tabs in arrival order
     QVector<CellListItemWidget*> m_cellWidgets;
     int m_selectedCellIndex;
     QString m_currentFilePath;
 
+    // Re-filtering: one rethreshold per event loop pass while a slider is dragged
+    struct ImageThresholds {
+        double conf;
+        double iou;
+    };
+    ImageProcessor* m_thresholdProcessor;
+    ImageProcessor::YoloParams m_thresholdParams;
+    QTimer* m_thresholdTimer;
+    QMap<QString, ImageThresholds> m_thresholdsByFile;
+    QMap<QString, QVector<cv::Rect>> m_removedByFile;  // рамки удаленных вручную клеток
+
     // Lazy loading optimization
     QTimer* m_thumbnailLoadTimer;
     int m_thumbnailLoadIndex;
@@ -0,0 +1,295 @@
+// yolodecoder.cpp - Candidate decoding for the YOLOv8 detection/segmentation head
+#include "yolodecoder.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+
+namespace {
+
+const int kMaxClasses = 2;      // cell / droplet
+const int kMaskCoeffs = 32;
+
+using Layout = YoloHead::Layout;
+
+// Рабочие буферы потока: не перевыделяются от изображения к изображению
+struct DecodeScratch {
+    std::vector<float> best;
+    std::vector<int> bestClass;
+    std::vector<int> survivors;
+
+    static DecodeScratch& local(int numAnchors) {
+        static thread_local DecodeScratch scratch;
+        scratch.best.resize(numAnchors);
+        scratch.bestClass.resize(numAnchors);
+        scratch.survivors.clear();
+        return scratch;
+    }
+};
+
+// best[i] = max_c scores[c][i], bestClass[i] = argmax. Строки классов непрерывны,
+// шаг между ними - stride элементов. NumClasses <= 0 - число классов задано в runtime.
+template <int NumClasses>
+void bestClassPerAnchor(const float* scores, size_t stride, int runtimeClasses, int numAnchors,
+                        float* best, int* bestClass) {
+    const int numClasses = NumClasses > 0 ? NumClasses : runtimeClasses;
+    int i = 0;
+#if CV_SIMD128
+    for (; i <= numAnchors - 4; i += 4) {
+        cv::v_float32x4 vbest = cv::v_load(scores + i);
+        cv::v_int32x4 vclass = cv::v_setall_s32(0);
+        for (int c = 1; c < numClasses; ++c) {
+            cv::v_float32x4 v = cv::v_load(scores + c * stride + i);
+            cv::v_float32x4 greater = v > vbest;
+            vbest = cv::v_select(greater, v, vbest);
+            vclass = cv::v_select(cv::v_reinterpret_as_s32(greater), cv::v_setall_s32(c), vclass);
+        }
+        cv::v_store(best + i, vbest);
+        cv::v_store(bestClass + i, vclass);
+    }
+#endif
+    for (; i < numAnchors; ++i) {
+        float value = scores[i];
+        int cls = 0;
+        for (int c = 1; c < numClasses; ++c) {
+            float v = scores[c * stride + i];
+            if (v > value) {
+                value = v;
+                cls = c;
+            }
+        }
+        best[i] = value;
+        bestClass[i] = cls;
+    }
+}
+
+// Индексы якорей с best >= threshold, по возрастанию
+void compactAboveThreshold(const float* best, int numAnchors, float threshold, std::vector<int>& survivors) {
+    int i = 0;
+#if CV_SIMD128
+    const cv::v_float32x4 vthreshold = cv::v_setall_f32(threshold);
+    for (; i <= numAnchors - 4; i += 4) {
+        int bits = cv::v_signmask(cv::v_load(best + i) >= vthreshold);
+        for (int lane = 0; bits != 0; ++lane, bits >>= 1) {
+            if (bits & 1) {
+                survivors.push_back(i + lane);
+            }
+        }
+    }
+#endif
+    for (; i < numAnchors; ++i) {
+        if (best[i] >= threshold) {
+            survivors.push_back(i);
+        }
+    }
+}
+
+void reserveCandidates(AnchorCandidates& candidates, size_t count) {
+    candidates.anchors.reserve(count);
+    candidates.scores.reserve(count);
+    candidates.classIds.reserve(count);
+    candidates.boxes.reserve(count);
+}
+
+// Декодер головы. NumClasses > 0 - специализация с известной формой выхода
+// (число признаков = 4 + NumClasses + маска); NumClasses == 0 - общий случай,
+// форма берется из head.
+template <Layout L, int NumClasses, bool HasMask>
+void decodeHead(const cv::Mat& output, const YoloHead& head, float confThreshold,
+                AnchorCandidates& candidates) {
+    const int numClasses = NumClasses > 0 ? NumClasses : head.numClasses;
+    const int numAnchors = head.numAnchors;
+    const float* data = output.ptr<float>(0);
+
+    if constexpr (L == Layout::ChannelMajor) {
+        const size_t stride = static_cast<size_t>(numAnchors);
+        DecodeScratch& scratch = DecodeScratch::local(numAnchors);
+
+        bestClassPerAnchor<NumClasses>(data + 4 * stride, stride, numClasses, numAnchors,
+                                       scratch.best.data(), scratch.bestClass.data());
+        compactAboveThreshold(scratch.best.data(), numAnchors, confThreshold, scratch.survivors);
+
+        // Только выжившие: чтение четырех строк рамки по индексу якоря
+        const float* cxRow = data;
+        const float* cyRow = data + stride;
+        const float* wRow = data + 2 * stride;
+        const float* hRow = data + 3 * stride;
+
+        reserveCandidates(candidates, scratch.survivors.size());
+        for (int a : scratch.survivors) {
+            candidates.anchors.push_back(a);
+            candidates.scores.push_back(scratch.best[a]);
+            candidates.classIds.push_back(scratch.bestClass[a]);
+            candidates.boxes.emplace_back(cxRow[a], cyRow[a], wRow[a], hRow[a]);
+        }
+    } else {
+        constexpr int kFixedFeatures = NumClasses > 0 ? 4 + NumClasses + (HasMask ? kMaskCoeffs : 0) : 0;
+        const int numFeatures = kFixedFeatures > 0 ? kFixedFeatures : head.numFeatures;
+
+        for (int a = 0; a < numAnchors; ++a) {
+            const float* row = data + static_cast<size_t>(a) * numFeatures;
+            const float* scores = row + 4;
+
+            float best = scores[0];
+            int cls = 0;
+            for (int c = 1; c < numClasses; ++c) {
+                if (scores[c] > best) {
+                    best = scores[c];
+                    cls = c;
+                }
+            }
+            if (best < confThreshold) {
+                continue;
+            }
+
+            candidates.anchors.push_back(a);
+            candidates.scores.push_back(best);
+            candidates.classIds.push_back(cls);
+            candidates.boxes.emplace_back(row[0], row[1], row[2], row[3]);
+        }
+    }
+}
+
+struct DecoderVariant {
+    Layout layout;
+    int numClasses;
+    bool hasMask;
+    YoloDecoder::DecodeFn fn;
+    const char* name;
+};
+
+// Известные головы. Новая голова - новая строка в этой таблице.
+const DecoderVariant kVariants[] = {
+    {Layout::ChannelMajor, 2, true,  &decodeHead<Layout::ChannelMajor, 2, true>,  "seg-2cls-channel-major"},
+    {Layout::Transposed,   2, true,  &decodeHead<Layout::Transposed,   2, true>,  "seg-2cls-transposed"},
+    {Layout::ChannelMajor, 2, false, &decodeHead<Layout::ChannelMajor, 2, false>, "det-2cls-channel-major"},
+    {Layout::Transposed,   2, false, &decodeHead<Layout::Transposed,   2, false>, "det-2cls-transposed"},
+    {Layout::ChannelMajor, 1, true,  &decodeHead<Layout::ChannelMajor, 1, true>,  "seg-1cls-channel-major"},
+    {Layout::Transposed,   1, true,  &decodeHead<Layout::Transposed,   1, true>,  "seg-1cls-transposed"},
+    {Layout::ChannelMajor, 1, false, &decodeHead<Layout::ChannelMajor, 1, false>, "det-1cls-channel-major"},
+    {Layout::Transposed,   1, false, &decodeHead<Layout::Transposed,   1, false>, "det-1cls-transposed"},
+};
+
+} // namespace
+
+void AnchorCandidates::clear() {
+    anchors.clear();
+    scores.clear();
+    classIds.clear();
+    boxes.clear();
+}
+
+int yoloAnchorCount(const cv::Size& inputSize) {
+    int count = 0;
+    for (int stride : {8, 16, 32}) {
+        count += (inputSize.width / stride) * (inputSize.height / stride);
+    }
+    return count;
+}
+
+YoloHead detectYoloHead(const cv::Mat& output, int expectedAnchors) {
+    YoloHead head;
+    if (output.dims != 3 || output.type() != CV_32F) {
+        return head;
+    }
+
+    int dim1 = output.size[1];
+    int dim2 = output.size[2];
+
+    // Якорей всегда больше, чем признаков; ожидаемое число разрешает
+    // неоднозначность, если вход нестандартный
+    bool anchorsLast = expectedAnchors > 0
+        ? (dim2 == expectedAnchors || (dim1 != expectedAnchors && dim2 > dim1))
+        : dim2 > dim1;
+
+    if (anchorsLast) {
+        head.layout = YoloHead::Layout::ChannelMajor;
+        head.numFeatures = dim1;
+        head.numAnchors = dim2;
+    } else {
+        head.layout = YoloHead::Layout::Transposed;
+        head.numAnchors = dim1;
+        head.numFeatures = dim2;
+    }
+
+    if (head.numFeatures <= 4) {
+        return YoloHead();
+    }
+
+    // YOLOv8-seg: 4 box + 2 класса + 32 коэффициента маски. Остальные признаки
+    // после первых двух классов не считаются классами (как и раньше).
+    head.numClasses = std::min(kMaxClasses, head.numFeatures - 4);
+    head.maskCoeffs = (head.numFeatures - 4 - head.numClasses == kMaskCoeffs) ? kMaskCoeffs : 0;
+    return head;
+}
+
+YoloDecoder selectYoloDecoder(const YoloHead& head) {
+    YoloDecoder decoder;
+    decoder.head = head;
+    if (!head.isValid()) {
+        return decoder;
+    }
+
+    const bool hasMask = head.maskCoeffs > 0;
+    for (const DecoderVariant& variant : kVariants) {
+        int features = 4 + variant.numClasses + (variant.hasMask ? kMaskCoeffs : 0);
+        if (variant.layout == head.layout && variant.numClasses == head.numClasses &&
+            variant.hasMask == hasMask && features == head.numFeatures) {
+            decoder.fn = variant.fn;
+            decoder.name = variant.name;
+            return decoder;
+        }
+    }
+
+    if (head.layout == Layout::ChannelMajor) {
+        decoder.fn = &decodeHead<Layout::ChannelMajor, 0, false>;
+        decoder.name = "generic-channel-major";
+    } else {
+        decoder.fn = &decodeHead<Layout::Transposed, 0, false>;
+        decoder.name = "generic-transposed";
+    }
+    return decoder;
+}
+
+bool YoloDecoder::matches(const cv::Mat& output) const {
+    if (!isValid() || output.dims != 3) {
+        return false;
+    }
+    const bool channelMajor = head.layout == Layout::ChannelMajor;
+    const int features = channelMajor ? output.size[1] : output.size[2];
+    const int anchors = channelMajor ? output.size[2] : output.size[1];
+    return features == head.numFeatures && anchors == head.numAnchors;
+}
+
+void YoloDecoder::decode(const cv::Mat& output, float confThreshold, AnchorCandidates& candidates) const {
+    candidates.clear();
+    // Выход должен иметь ту же форму, для которой выбран декодер
+    if (!matches(output) || !output.isContinuous()) {
+        return;
+    }
+
+    fn(output, head, confThreshold, candidates);
+}
+
+cv::Mat gatherMaskCoefficients(const cv::Mat& output, const YoloHead& head, const std::vector<int>& anchors) {
+    if (head.maskCoeffs <= 0 || anchors.empty() || !output.isContinuous()) {
+        return cv::Mat();
+    }
+
+    const float* data = output.ptr<float>(0);
+    const int first = 4 + head.numClasses;
+    cv::Mat coefficients(static_cast<int>(anchors.size()), head.maskCoeffs, CV_32F);
+
+    for (size_t k = 0; k < anchors.size(); ++k) {
+        float* dst = coefficients.ptr<float>(static_cast<int>(k));
+        const int a = anchors[k];
+        if (head.layout == Layout::ChannelMajor) {
+            const size_t stride = static_cast<size_t>(head.numAnchors);
+            for (int c = 0; c < head.maskCoeffs; ++c) {
+                dst[c] = data[(first + c) * stride + a];
+            }
+        } else {
+            const float* row = data + static_cast<size_t>(a) * head.numFeatures + first;
+            std::copy(row, row + head.maskCoeffs, dst);
+        }
+    }
+    return coefficients;
+}
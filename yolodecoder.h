@@ -0,0 +1,71 @@
+// yolodecoder.h - Candidate decoding for the YOLOv8 detection/segmentation head
+#ifndef YOLODECODER_H
+#define YOLODECODER_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Описание выхода головы YOLOv8: [1, features, anchors] (channel-major, как
+// экспортирует Ultralytics) или [1, anchors, features] (транспонированный).
+// features = 4 (box) + numClasses + maskCoeffs.
+struct YoloHead {
+    enum class Layout {
+        Unknown,
+        ChannelMajor,   // [1, features, anchors]
+        Transposed      // [1, anchors, features]
+    };
+
+    Layout layout = Layout::Unknown;
+    int numFeatures = 0;
+    int numAnchors = 0;
+    int numClasses = 0;
+    int maskCoeffs = 0;
+
+    bool isValid() const { return layout != Layout::Unknown; }
+};
+
+// Якоря, прошедшие порог уверенности, в координатах входа сети
+struct AnchorCandidates {
+    std::vector<int> anchors;       // индекс якоря (строка коэффициентов маски)
+    std::vector<float> scores;
+    std::vector<int> classIds;
+    std::vector<cv::Vec4f> boxes;   // cx, cy, w, h
+
+    size_t size() const { return anchors.size(); }
+    void clear();
+};
+
+// Число якорей YOLOv8 для входа inputSize: сетки со страйдами 8, 16 и 32
+// (640x640 -> 8400, 1024x1024 -> 21504, 320x320 -> 2100)
+int yoloAnchorCount(const cv::Size& inputSize);
+
+YoloHead detectYoloHead(const cv::Mat& output, int expectedAnchors);
+
+// Декодер, выбранный один раз для загруженной модели. Известные головы
+// (layout x число классов x наличие маски) - шаблонные специализации с
+// постоянным числом итераций во внутренних циклах; прочие формы выхода
+// обрабатываются общим кодом.
+//
+// decode: максимум по строкам классов (SIMD), маска score >= confThreshold и
+// компактизация выживших до какой-либо математики по рамкам. Channel-major
+// выход читается построчно без транспонирования.
+struct YoloDecoder {
+    using DecodeFn = void (*)(const cv::Mat& output, const YoloHead& head, float confThreshold,
+                              AnchorCandidates& candidates);
+
+    YoloHead head;
+    DecodeFn fn = nullptr;
+    const char* name = "none";
+
+    bool isValid() const { return fn != nullptr; }
+    bool matches(const cv::Mat& output) const;  // декодер выбран для выхода такой формы
+    void decode(const cv::Mat& output, float confThreshold, AnchorCandidates& candidates) const;
+};
+
+YoloDecoder selectYoloDecoder(const YoloHead& head);
+
+// Коэффициенты маски выбранных якорей: [anchors.size() x head.maskCoeffs], CV_32F.
+// Пустая матрица, если голова без масок.
+cv::Mat gatherMaskCoefficients(const cv::Mat& output, const YoloHead& head, const std::vector<int>& anchors);
+
+#endif // YOLODECODER_H